@@ -4,89 +4,461 @@
 #include <mutex>
 #include <thread>
 #include <memory>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <algorithm>
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
 #include "buffer.hpp"
+#include "metrics.hpp"
 
 namespace log_system
 {
 #define DEFAULT_ASYN_THREAD_SIZE 2 // 默认的异步工作线程池中的工作线程数量
-    // 异步工作线程池模块，采用双缓冲区的思想实现,设计为单例，将来所有的Asynlogger共用同一套异步工作线程池，已保证其提供的所有操作的线程安全
+#define DEFAULT_SPIN_ROUNDS 16     // 工作线程默认的自旋轮数，第i轮执行2^min(i,MAX_SPIN_SHIFT)次CPU暂停指令
+#define DEFAULT_YIELD_ROUNDS 4     // 工作线程自旋结束后默认的让出CPU的次数
+#define LATENCY_SPIN_ROUNDS 256    // 低延迟模式下工作线程的自旋轮数
+#define LATENCY_YIELD_ROUNDS 64    // 低延迟模式下工作线程让出CPU的次数
+#define MAX_SPIN_SHIFT 6           // 自旋的指数退避上限
+#define MAX_GROUP_COMMIT 256       // 一次组提交最多包含的要求同步的日志条数，超过后即使缓冲区尚未处理完也先提交一次
+    // 工作线程的唤醒模式，决定了工作线程在没有数据时自旋多久才挂起
+    enum AsynWakeMode
+    {
+        WAKE_BALANCED = 0, // 短暂自旋后挂起，兼顾延迟和CPU占用
+        WAKE_LATENCY,      // 长时间自旋后才挂起，日志到达后能更快被处理，但空闲时占用更多CPU
+        WAKE_CPU           // 不自旋直接挂起，CPU占用最低
+    };
+    // 异步工作线程池的配置
+    struct AsynPoolConfig
+    {
+        size_t _thread_size = DEFAULT_ASYN_THREAD_SIZE; // 工作线程数量，按NUMA节点划分队列时为每个节点的工作线程数量
+        size_t _buffer_size = BUFFER_SIZE;              // 单个缓冲区最多可容纳的日志条数(即队列容量)
+        std::vector<int> _cpus;                         // 工作线程允许运行的CPU编号，为空表示不设置CPU亲和性
+        int _nice = 0;                                  // 工作线程的nice值(-20~19，越小优先级越高)，为0表示不修改
+        bool _numa = false;                             // 是否按NUMA节点划分队列，无法获取NUMA拓扑时退化为单个队列
+        size_t _spin_rounds = DEFAULT_SPIN_ROUNDS;      // 工作线程没有数据时挂起前的自旋轮数(指数退避)
+        size_t _yield_rounds = DEFAULT_YIELD_ROUNDS;    // 自旋结束后挂起前让出CPU的次数
+        // 按唤醒模式设置自旋和让出CPU的次数
+        void set_wake_mode(AsynWakeMode mode)
+        {
+            _spin_rounds = mode == WAKE_LATENCY ? LATENCY_SPIN_ROUNDS : (mode == WAKE_CPU ? 0 : DEFAULT_SPIN_ROUNDS);
+            _yield_rounds = mode == WAKE_LATENCY ? LATENCY_YIELD_ROUNDS : (mode == WAKE_CPU ? 0 : DEFAULT_YIELD_ROUNDS);
+        }
+    };
+
+    // 异步工作线程池模块，采用双缓冲区的思想实现，已保证其提供的所有操作的线程安全
+    // 默认所有的Asynlogger共用同一个单例线程池(get_instance())，也可以通过create_pool()创建具有独立队列容量、
+    // 线程数量、CPU亲和性和优先级的命名线程池，在添加日志器时指定使用，使不同日志器之间互不影响
+    // 线程池内部由一条或多条队列(Lane)组成，每条队列有自己的双缓冲区和工作线程；开启_numa后每个NUMA节点一条队列，
+    // 该队列的工作线程绑定在节点内的CPU上，生产者线程第一次放入数据时根据所在的CPU确定所属节点，之后固定放入该节点的队列，
+    // 避免不同节点的生产者争用同一个缓冲区的缓存行；同一生产者线程的日志总是进入同一条队列，保持输出顺序；
+    // 不同队列的工作线程各自把日志交给落地对象，落地对象只按到达顺序输出，不按时间戳合并，因此不保证跨队列的先后顺序，
+    // 不同节点上的线程输出的日志在文件中可能时间戳倒序
+    // 工作线程没有数据时先按指数退避自旋，再让出几次CPU，仍没有数据才挂起；生产者只在有工作线程挂起时才发出通知，
+    // 工作线程交换缓冲区后也只在有生产者因缓冲区已满而等待时才通知，避免每条日志都产生futex系统调用
+    // 带有完成通知且要求同步的日志写入后先暂存在工作线程中，处理完当前缓冲区(或暂存达到MAX_GROUP_COMMIT条)时，
+    // 对涉及的每个落地对象只调用一次flush()，再一起完成这些日志的通知，使多条需要持久化的日志共用一次fsync()
     class AsynWorkerPool
     {
     public:
         using func_t = std::function<bool(const Buffer_data &buffer)>;
         using ptr = std::shared_ptr<AsynWorkerPool>;
+        // 析构时通知所有工作线程处理完缓冲区中剩余的数据后退出，再回收所有工作线程
         ~AsynWorkerPool()
         {
+            for (auto &lane : _lanes)
+            {
+                {
+                    std::unique_lock<std::mutex> push_lock(lane->_push_mutex);
+                    lane->_stop = true;
+                }
+                lane->_pop_cond.notify_all();
+            }
             for (auto &thread : _threads)
                 thread.join();
         }
         // 向线程池的缓冲区中放入日志数据，将来让异步工作线程读取并处理
-        bool push(const Buffer_data &buffer_data)
+        // completion不为nullptr时，工作线程写入(和同步)该日志后通过它通知调用者
+        bool push(const LogSink::ptr &sink, const std::string &log_str, Level::value level, const LogCompletion::ptr &completion = nullptr)
         {
-            std::unique_lock<std::mutex> push_lock(_push_mutex);
-            _push_cond.wait(push_lock, [&]()
-                            { return !_push_tasks.is_full(); });
-            if (!_push_tasks.push(buffer_data))
+            Lane &lane = local_lane();
+            std::unique_lock<std::mutex> push_lock(lane._push_mutex);
+            if (lane._push_tasks.is_full()) // 只有需要阻塞时才计时，不增加正常放入数据时的开销
+            {
+                auto start = std::chrono::steady_clock::now();
+                lane._push_waiters++;
+                lane._push_cond.wait(push_lock, [&]()
+                                     { return !lane._push_tasks.is_full(); });
+                lane._push_waiters--;
+                auto end = std::chrono::steady_clock::now();
+                lane._push_blocks++;
+                _push_block_latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            }
+            if (!lane._push_tasks.push(sink, log_str, level, completion))
                 return false;
-            _pop_cond.notify_all();
+            lane._push_count++;
+            lane._push_size.store(lane._push_tasks.size(), std::memory_order_release);
+            if (lane._parked > 0 && !lane._wake_pending) // 工作线程都在自旋或处理数据、或已经通知过时无需再通知
+            {
+                lane._wake_pending = true;
+                lane._notifies++;
+                lane._pop_cond.notify_one();
+            }
             return true;
         }
-        // 获取线程池的单例对象,要传入回调函数func和要创建的线程数量,但这两个参数只有全局内第一次调用get_instance()时才会用上
+        // 阻塞等待，直到调用flush()之前放入线程池的所有日志数据都已被工作线程处理完毕
+        // 逐条队列等待，每条队列只需等到调用flush()时已放入的数据处理完毕，等待期间新放入的数据不影响结果
+        void flush()
+        {
+            for (auto &lane : _lanes)
+            {
+                size_t target;
+                {
+                    std::unique_lock<std::mutex> push_lock(lane->_push_mutex);
+                    target = lane->_push_count;
+                }
+                std::unique_lock<std::mutex> flush_lock(_flush_mutex);
+                _flush_waiters++;
+                _flush_cond.wait(flush_lock, [&]()
+                                 { return lane->_done_count.load() >= target; });
+                _flush_waiters--;
+            }
+        }
+        // 获取线程池的统计数据快照
+        PoolMetricsSnapshot metrics()
+        {
+            PoolMetricsSnapshot snap;
+            snap._name = _name;
+            for (auto &lane : _lanes)
+            {
+                // 统计数据都受_push_mutex保护或是原子变量，不需要加_pop_mutex
+                std::unique_lock<std::mutex> push_lock(lane->_push_mutex);
+                snap._pushed += lane->_push_count;
+                snap._swaps += lane->_swap_count;
+                snap._push_blocks += lane->_push_blocks;
+                snap._notifies += lane->_notifies;
+                snap._parks += lane->_parks;
+                snap._processed += lane->_done_count.load();
+                snap._group_commits += lane->_group_commits.load(std::memory_order_relaxed);
+                snap._committed += lane->_committed.load(std::memory_order_relaxed);
+            }
+            snap._queue_depth = snap._pushed > snap._processed ? snap._pushed - snap._processed : 0;
+            snap._push_block = _push_block_latency.snapshot();
+            return snap;
+        }
+        const std::string &name() const { return _name; }
+        // 线程池中队列的数量，未按NUMA节点划分时为1
+        size_t lane_count() const { return _lanes.size(); }
+        // 获取默认线程池的单例对象,要传入回调函数func和要创建的线程数量,但这两个参数只有全局内第一次调用get_instance()时才会用上
         static AsynWorkerPool::ptr get_instance(func_t func, size_t thread_size = DEFAULT_ASYN_THREAD_SIZE)
         {
-            static AsynWorkerPool::ptr awp(new AsynWorkerPool(func, thread_size));
+            static AsynWorkerPool::ptr awp(new AsynWorkerPool("default", func, make_config(thread_size)));
             return awp;
         }
+        // 根据配置创建名为name的线程池，名称为空、为默认线程池的名称"default"、已经存在或配置不合法时返回false
+        static bool create_pool(const std::string &name, func_t func, const AsynPoolConfig &config)
+        {
+            if (name == "" || name == "default" || config._thread_size == 0 || config._buffer_size == 0)
+                return false;
+            std::unique_lock<std::mutex> poolhash_lock(_poolhash_mutex);
+            if (_poolhash.find(name) != _poolhash.end())
+                return false;
+            _poolhash[name] = AsynWorkerPool::ptr(new AsynWorkerPool(name, func, config));
+            return true;
+        }
+        // 移除名为name的线程池，已经使用它的日志器仍持有该线程池直到日志器被释放，用于撤销加载失败的配置中新建的线程池
+        static void remove_pool(const std::string &name)
+        {
+            AsynWorkerPool::ptr pool;
+            {
+                std::unique_lock<std::mutex> poolhash_lock(_poolhash_mutex);
+                auto it = _poolhash.find(name);
+                if (it == _poolhash.end())
+                    return;
+                pool = std::move(it->second);
+                _poolhash.erase(it);
+            }
+            // 线程池在锁外析构，析构时会等待其工作线程退出
+        }
+        // 根据名称获取已经创建的线程池，不存在则返回nullptr
+        static AsynWorkerPool::ptr get_pool(const std::string &name)
+        {
+            std::unique_lock<std::mutex> poolhash_lock(_poolhash_mutex);
+            auto it = _poolhash.find(name);
+            if (it == _poolhash.end())
+                return AsynWorkerPool::ptr(nullptr);
+            return it->second;
+        }
 
     private:
-        AsynWorkerPool(func_t func, size_t thread_size = DEFAULT_ASYN_THREAD_SIZE)
-            : _func(func) // , _threads(thread_size, std::thread(&AsynWorkerPool::worker_thread, this))\
-                            vector的这种方式使用方式并不适用于std::thread,因为vector是先通过给的值(第二个参数)构造一个对象, \
-                            在开辟好空间后再通过先前构造好的对象，循环进行要创建的对象个数(第一个参数的值)次拷贝构造来填充vector开辟的空间中的值 \
-                            而std::thread中,拷贝构造函数是被删除的函数,所以以上用法会报错,只能通过以下用法来插入一个个std::thread到vector
+        // 一条队列，包含一组双缓冲区和处理它们的工作线程，不同队列之间互不共享锁和缓冲区
+        struct alignas(64) Lane
         {
-            _threads.reserve(thread_size);
-            for (size_t i = 0; i < thread_size; i++)
-                _threads.push_back(std::thread(&AsynWorkerPool::worker_thread, this));
+            Lane(size_t buffer_size) : _push_tasks(buffer_size), _pop_tasks(buffer_size) {}
+            std::vector<int> _cpus;                  // 该队列的工作线程允许运行的CPU编号，为空表示不设置CPU亲和性
+            bool _stop = false;                      // 队列停止标志，受_push_mutex保护
+            std::mutex _push_mutex;                  // 互斥锁，保证_push_tasks缓冲区的线程安全
+            std::mutex _pop_mutex;                   // 互斥锁，保证_pop_tasks缓冲区的线程安全
+            std::condition_variable _push_cond;      // 条件变量，不满足放入数据条件时外部线程就在该条件变量下等待
+            std::condition_variable _pop_cond;       // 条件变量，不满足读取数据条件时异步工作线程就在该条件变量下等待
+            Buffer _push_tasks;                      // 外部线程放入数据的缓冲区
+            Buffer _pop_tasks;                       // 异步工作线程读取数据的缓冲区
+            size_t _push_count = 0;                  // 已放入该队列的日志数据条数，受_push_mutex保护
+            std::atomic<size_t> _done_count{0};      // 已被工作线程处理完毕的日志数据条数，要求同步的日志在组提交后才计入
+            uint64_t _swap_count = 0;                // 双缓冲区的交换次数，受_push_mutex保护
+            uint64_t _push_blocks = 0;               // 生产者因缓冲区已满而阻塞的次数，受_push_mutex保护
+            size_t _parked = 0;                      // 挂起等待数据的工作线程数量，受_push_mutex保护
+            bool _wake_pending = false;              // 是否已通知挂起的工作线程但其尚未醒来，受_push_mutex保护
+            size_t _push_waiters = 0;                // 因缓冲区已满而等待的生产者数量，受_push_mutex保护
+            uint64_t _notifies = 0;                  // 生产者唤醒工作线程的次数，受_push_mutex保护
+            uint64_t _parks = 0;                     // 工作线程挂起的次数，受_push_mutex保护
+            std::atomic<size_t> _push_size{0};       // _push_tasks中的数据条数，供自旋的工作线程不加锁地检查
+            std::atomic<uint64_t> _group_commits{0}; // 组提交的次数
+            std::atomic<uint64_t> _committed{0};     // 通过组提交完成的日志条数
+        };
+        // 工作线程暂存的一条已写入、等待组提交的日志
+        struct PendingCommit
+        {
+            LogSink::ptr _sink;
+            LogCompletion::ptr _completion;
+            bool _ok; // 写入是否成功
+        };
+        AsynWorkerPool(const std::string &name, func_t func, const AsynPoolConfig &config)
+            : _name(name), _func(func), _config(config)
+        // , _threads(thread_size, std::thread(&AsynWorkerPool::worker_thread, this))
+        // vector的这种方式使用方式并不适用于std::thread,因为vector是先通过给的值(第二个参数)构造一个对象,
+        // 在开辟好空间后再通过先前构造好的对象，循环进行要创建的对象个数(第一个参数的值)次拷贝构造来填充vector开辟的空间中的值
+        // 而std::thread中,拷贝构造函数是被删除的函数,所以以上用法会报错,只能通过以下用法来插入一个个std::thread到vector
+        {
+            if (config._numa)
+                create_numa_lanes();
+            if (_lanes.empty())
+            {
+                _lanes.emplace_back(new Lane(config._buffer_size));
+                _lanes[0]->_cpus = config._cpus;
+            }
+            _threads.reserve(config._thread_size * _lanes.size());
+            for (auto &lane : _lanes)
+            {
+                for (size_t i = 0; i < config._thread_size; i++)
+                    _threads.push_back(std::thread(&AsynWorkerPool::worker_thread, this, lane.get()));
+            }
         }
         AsynWorkerPool(const AsynWorkerPool &tp) = delete;
         AsynWorkerPool &operator=(const AsynWorkerPool &tp) = delete;
-        // 异步工作线程的运行函数
-        void worker_thread()
+        static AsynPoolConfig make_config(size_t thread_size)
+        {
+            AsynPoolConfig config;
+            config._thread_size = thread_size;
+            return config;
+        }
+        // 为每个拥有可用CPU的NUMA节点创建一条队列，配置了_cpus时只使用节点内同时出现在_cpus中的CPU
+        // 只有一个可用节点时不创建，由调用者退化为单个队列
+        void create_numa_lanes()
+        {
+            auto &nodes = Util::numa_nodes();
+            std::vector<std::unique_ptr<Lane>> lanes;
+            std::vector<int> node_lane(nodes.size(), -1);
+            for (size_t node = 0; node < nodes.size(); node++)
+            {
+                std::vector<int> cpus;
+                for (int cpu : nodes[node])
+                {
+                    if (_config._cpus.empty() || std::find(_config._cpus.begin(), _config._cpus.end(), cpu) != _config._cpus.end())
+                        cpus.push_back(cpu);
+                }
+                if (cpus.empty())
+                    continue;
+                node_lane[node] = (int)lanes.size();
+                lanes.emplace_back(new Lane(_config._buffer_size));
+                lanes.back()->_cpus = cpus;
+            }
+            if (lanes.size() < 2)
+                return;
+            _lanes = std::move(lanes);
+            _node_lane = std::move(node_lane);
+        }
+        // 获取当前线程应当放入的队列，线程所属的NUMA节点只在第一次调用时通过sched_getcpu()确定，之后保持不变
+        // 节点上没有该线程池的队列(如_cpus排除了该节点)时，按节点编号均匀分配到各个队列
+        Lane &local_lane()
+        {
+            if (_lanes.size() == 1)
+                return *_lanes[0];
+            thread_local int node = Util::cpu_node(sched_getcpu());
+            if (node >= 0 && node < (int)_node_lane.size() && _node_lane[node] >= 0)
+                return *_lanes[_node_lane[node]];
+            return *_lanes[(node < 0 ? 0 : node) % _lanes.size()];
+        }
+        // 按照配置设置当前工作线程的CPU亲和性和优先级，设置失败不影响工作线程的运行
+        void setup_thread(const Lane &lane)
+        {
+            if (!lane._cpus.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (int cpu : lane._cpus)
+                {
+                    if (cpu >= 0 && cpu < CPU_SETSIZE)
+                        CPU_SET(cpu, &set);
+                }
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            }
+            if (_config._nice != 0)
+                setpriority(PRIO_PROCESS, (id_t)Util::thread_info()._tid, _config._nice); // Linux下nice值是线程级别的属性
+        }
+        // 在不加_push_mutex的情况下等待lane中出现新的数据：先按指数退避自旋，再让出CPU，都没有等到时返回，由调用者挂起
+        void spin_wait(Lane &lane)
+        {
+            for (size_t i = 0; i < _config._spin_rounds; i++)
+            {
+                if (lane._push_size.load(std::memory_order_acquire) > 0)
+                    return;
+                size_t n = 1ull << (i < MAX_SPIN_SHIFT ? i : MAX_SPIN_SHIFT);
+                for (size_t j = 0; j < n; j++)
+                    Util::cpu_relax();
+            }
+            for (size_t i = 0; i < _config._yield_rounds; i++)
+            {
+                if (lane._push_size.load(std::memory_order_acquire) > 0)
+                    return;
+                std::this_thread::yield();
+            }
+        }
+        // 组提交：对pending中涉及的每个落地对象只调用一次flush()，再按写入和同步的结果完成所有日志的通知
+        void group_commit(Lane &lane, std::vector<PendingCommit> &pending, std::vector<std::pair<LogSink *, bool>> &synced)
+        {
+            synced.clear();
+            for (auto &commit : pending)
+            {
+                bool ok = true, found = false;
+                for (auto &sink : synced)
+                {
+                    if (sink.first == commit._sink.get())
+                        ok = sink.second, found = true;
+                }
+                if (!found)
+                {
+                    ok = commit._sink->flush();
+                    synced.emplace_back(commit._sink.get(), ok);
+                }
+                commit._completion->finish(commit._ok && ok);
+            }
+            lane._group_commits.fetch_add(1, std::memory_order_relaxed);
+            lane._committed.fetch_add(pending.size(), std::memory_order_relaxed);
+            finish_records(lane, pending.size());
+            pending.clear();
+        }
+        // 将n条日志数据计为处理完毕，并在有线程等待flush()时通知
+        void finish_records(Lane &lane, size_t n)
+        {
+            lane._done_count += n;
+            if (_flush_waiters.load() > 0) // 只有存在等待flush()的线程时才进行通知
+            {
+                std::unique_lock<std::mutex> flush_lock(_flush_mutex);
+                _flush_cond.notify_all();
+            }
+        }
+        // 异步工作线程的运行函数，只处理lane队列中的数据
+        // 工作线程只在交换缓冲区和取出数据时持有_pop_mutex，自旋和挂起等待新数据时不持有，
+        // 因此暂存着待组提交日志的工作线程不会因等待_pop_mutex而被挂起的其他工作线程无限期阻塞
+        void worker_thread(Lane *lane)
         {
+            setup_thread(*lane);
+            Buffer_data data; // 在循环外定义，使其持有的空间可以与缓冲区中的元素交换复用
+            data._log_str.reserve(DEFAULT_BUFFER_DATA_RESERVE);
+            std::vector<PendingCommit> pending;             // 等待组提交的日志
+            std::vector<std::pair<LogSink *, bool>> synced; // 组提交时已经同步过的落地对象及其结果
+            pending.reserve(MAX_GROUP_COMMIT);
             while (1)
             {
-                Buffer_data data;
+                bool batch_end;
                 {
-                    std::unique_lock<std::mutex> pop_lock(_pop_mutex);
-                    if (_pop_tasks.is_empty())
+                    std::unique_lock<std::mutex> pop_lock(lane->_pop_mutex);
+                    if (lane->_pop_tasks.is_empty())
                     {
-                        std::unique_lock<std::mutex> push_lock(_push_mutex);
-                        _pop_cond.wait(push_lock, [&]()
-                                       { return !_push_tasks.is_empty(); });
-                        _pop_tasks.reset();
-                        _pop_tasks.swap(_push_tasks);
-                        _push_cond.notify_all();
+                        // 同一队列有多个工作线程时，缓冲区中的最后一条日志可能被其他工作线程取走，
+                        // 因此在等待新数据之前先提交自己暂存的日志，不能让它们等到下一批数据到来
+                        if (!pending.empty())
+                        {
+                            pop_lock.unlock();
+                            group_commit(*lane, pending, synced);
+                            continue;
+                        }
+                        std::unique_lock<std::mutex> push_lock(lane->_push_mutex);
+                        if (lane->_push_tasks.is_empty())
+                        {
+                            if (lane->_stop) // 线程池已停止且所有数据都已处理完毕
+                                return;
+                            push_lock.unlock();
+                            pop_lock.unlock();
+                            spin_wait(*lane);
+                            push_lock.lock();
+                            if (!lane->_stop && lane->_push_tasks.is_empty())
+                            {
+                                lane->_parked++;
+                                lane->_parks++;
+                                lane->_pop_cond.wait(push_lock, [&]()
+                                                     { return lane->_stop || !lane->_push_tasks.is_empty(); });
+                                lane->_parked--;
+                                lane->_wake_pending = false;
+                            }
+                            continue; // 重新按_pop_mutex、_push_mutex的顺序加锁，等待期间其他工作线程可能已经交换过缓冲区
+                        }
+                        lane->_pop_tasks.reset();
+                        lane->_pop_tasks.swap(lane->_push_tasks);
+                        lane->_push_size.store(0, std::memory_order_relaxed);
+                        lane->_swap_count++;
+                        lane->_wake_pending = false; // 被通知的工作线程可能发现数据已被其他工作线程取走而继续挂起，之后的数据需要重新通知
+                        if (lane->_push_waiters > 0)
+                            lane->_push_cond.notify_all();
                     }
-                    data = _pop_tasks.pop();
+                    if (!lane->_pop_tasks.pop(data))
+                        data._log_str.clear();
+                    batch_end = lane->_pop_tasks.is_empty();
                 }
-                if (data._log_str == "" || data._sink == nullptr)
-                    continue;
-                _func(data);
+                bool ok = false, deferred = false;
+                if (data._log_str != "" && data._sink != nullptr)
+                    ok = _func(data);
+                if (data._completion != nullptr)
+                {
+                    // 要求同步的日志在组提交时才计为处理完毕，使flush()返回时这些日志也已同步
+                    deferred = data._completion->sync() && data._sink != nullptr;
+                    if (deferred)
+                        pending.push_back(PendingCommit{data._sink, std::move(data._completion), ok});
+                    else
+                        data._completion->finish(ok);
+                    data._completion.reset();
+                }
+                data._sink.reset(); // 不在工作线程中保留对落地对象的引用
+                if (!deferred)
+                    finish_records(*lane, 1);
+                if (!pending.empty() && (batch_end || pending.size() >= MAX_GROUP_COMMIT))
+                    group_commit(*lane, pending, synced);
             }
         }
 
     private:
-        func_t _func;                       // 回调函数(其作用是告知异步工作线程如何处理读取上来的日志数据)
-        std::mutex _push_mutex;             // 互斥锁，保证_push_tasks缓冲区的线程安全
-        std::mutex _pop_mutex;              // 互斥锁，保证_pop_tasks缓冲区的线程安全
-        std::condition_variable _push_cond; // 条件变量，不满足放入数据条件时外部线程就在该条件变量下等待
-        std::condition_variable _pop_cond;  // 条件变量，不满足读取数据条件时异步工作线程就在该条件变量下等待
-        Buffer _push_tasks;                 // 外部线程放入数据的缓冲区
-        Buffer _pop_tasks;                  // 异步工作线程读取数据的缓冲区
-        std::vector<std::thread> _threads;  // 管理所有创建的异步工作线程的数组
+        std::string _name;                         // 线程池的名称，默认线程池的名称为"default"
+        func_t _func;                              // 回调函数(其作用是告知异步工作线程如何处理读取上来的日志数据)
+        AsynPoolConfig _config;                    // 线程池的配置
+        std::vector<std::unique_ptr<Lane>> _lanes; // 线程池中的所有队列，创建后不再修改
+        std::vector<int> _node_lane;               // NUMA节点编号到队列下标的映射，没有对应队列的节点为-1
+        std::vector<std::thread> _threads;         // 管理所有创建的异步工作线程的数组
+        std::atomic<int> _flush_waiters{0};        // 正在flush()中等待的线程数量
+        std::mutex _flush_mutex;                   // 与_flush_cond配合使用的互斥锁
+        std::condition_variable _flush_cond;       // 条件变量，调用flush()的线程在该条件变量下等待日志数据处理完毕
+        Histogram _push_block_latency;             // 生产者每次阻塞等待的耗时
+
+        static std::unordered_map<std::string, AsynWorkerPool::ptr> _poolhash; // 管理所有命名线程池，以名称作为唯一标识
+        static std::mutex _poolhash_mutex;                                     // 保证多线程操作_poolhash时的线程安全
     };
+    std::unordered_map<std::string, AsynWorkerPool::ptr> AsynWorkerPool::_poolhash;
+    std::mutex AsynWorkerPool::_poolhash_mutex;
 }
-#endif
\ No newline at end of file
+#endif
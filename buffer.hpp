@@ -4,29 +4,42 @@
 #include <vector>
 #include <string>
 #include "sink.hpp"
+#include "completion.hpp"
 
 namespace log_system
 {
-#define BUFFER_SIZE 1024 // 缓冲区的最大大小
+#define BUFFER_SIZE 1024               // 缓冲区默认的最大大小
+#define DEFAULT_BUFFER_DATA_RESERVE 256 // 缓冲区中每个元素的日志数据字符串预先分配的空间大小
 
-    // Buffer_data为Buffer缓冲区中的元素,其包含了一个要输出的日志数据字符串和一个日志落地对象，将来就通过该落地对象将日志输出
+    // Buffer_data为Buffer缓冲区中的元素,其包含了一个要输出的日志数据字符串、该日志的等级和一个日志落地对象，将来就通过该落地对象将日志输出
+    // 通过Logger::log_durable()输出的日志还带有完成通知，工作线程写入(和同步)后通过它通知调用者，普通日志的_completion为nullptr
     struct Buffer_data
     {
-        Buffer_data() : _log_str(""), _sink(nullptr) {}
-        Buffer_data(const LogSink::ptr &sink, const std::string &log_str) : _sink(sink), _log_str(log_str) {}
+        Buffer_data() : _log_str(""), _sink(nullptr), _level(Level::value::DEBUG) {}
+        Buffer_data(const LogSink::ptr &sink, const std::string &log_str, Level::value level = Level::value::DEBUG)
+            : _log_str(log_str), _sink(sink), _level(level) {}
         std::string _log_str;
         LogSink::ptr _sink;
+        Level::value _level;
+        LogCompletion::ptr _completion;
     };
 
     // 缓冲区类，为异步工作线程池的双缓冲区实现提供了各种调用接口，但其本身并不保证线程安全
+    // 缓冲区中的元素在创建时预先分配好空间并循环复用：写入时将日志拷贝到元素已有的空间中，读取时与调用者的元素交换内容，
+    // 因此稳定运行时放入和取出日志数据都不会产生内存分配
     class Buffer
     {
     public:
-        Buffer() : _reader_idx(0), _writer_idx(0), _buffer(BUFFER_SIZE) {}
+        Buffer(size_t capacity = BUFFER_SIZE) : _buffer(capacity == 0 ? 1 : capacity), _reader_idx(0), _writer_idx(0)
+        {
+            for (auto &data : _buffer)
+                data._log_str.reserve(DEFAULT_BUFFER_DATA_RESERVE);
+        }
         ~Buffer() {}
-        bool is_full() { return _writer_idx >= BUFFER_SIZE; }  // 判断缓冲区是否为满
-        bool is_empty() { return _reader_idx == _writer_idx; } // 判断缓冲区是否为空
-        void reset() { _reader_idx = _writer_idx = 0; }        // 将缓冲区的读写指针置0
+        bool is_full() { return _writer_idx >= _buffer.size(); } // 判断缓冲区是否为满
+        bool is_empty() { return _reader_idx == _writer_idx; }   // 判断缓冲区是否为空
+        void reset() { _reader_idx = _writer_idx = 0; }          // 将缓冲区的读写指针置0
+        size_t size() { return _writer_idx - _reader_idx; }     // 获取缓冲区中尚未读取的数据条数
         // 用于交换两个缓冲区，交换读写指针和缓冲区内的数据
         void swap(Buffer &buffer)
         {
@@ -35,19 +48,29 @@ namespace log_system
             _buffer.swap(buffer._buffer);
         }
         // 向缓冲区中插入数据，成功返回true，失败返回false
-        bool push(const Buffer_data &buffer_data)
+        bool push(const LogSink::ptr &sink, const std::string &log_str, Level::value level, const LogCompletion::ptr &completion = nullptr)
         {
             if (is_full())
                 return false;
-            _buffer[_writer_idx++] = buffer_data;
+            Buffer_data &data = _buffer[_writer_idx++];
+            data._sink = sink;
+            data._log_str.assign(log_str);
+            data._level = level;
+            data._completion = completion;
             return true;
         }
-        // 从缓冲区中读取数据，失败返回空的Buffer_data
-        Buffer_data pop()
+        // 从缓冲区中读取数据，读取到的日志字符串与buffer_data的内容交换，buffer_data原有的空间留在缓冲区中供之后复用，失败返回false
+        // 落地对象和完成通知则直接移出，缓冲区中不会残留对它们的引用，日志器销毁后其落地对象可以及时释放
+        bool pop(Buffer_data &buffer_data)
         {
             if (is_empty())
-                return Buffer_data();
-            return _buffer[_reader_idx++];
+                return false;
+            Buffer_data &data = _buffer[_reader_idx++];
+            buffer_data._log_str.swap(data._log_str);
+            buffer_data._sink = std::move(data._sink);
+            buffer_data._level = data._level;
+            buffer_data._completion = std::move(data._completion);
+            return true;
         }
 
     private:
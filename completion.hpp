@@ -0,0 +1,135 @@
+#ifndef LOG_SYSTEM_COMPLETION_HPP
+#define LOG_SYSTEM_COMPLETION_HPP
+
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define LOG_SYSTEM_HAVE_COROUTINE 1 // 以C++20编译时提供co_await接口
+#endif
+#endif
+
+namespace log_system
+{
+    // 日志完成通知，由Logger::log_durable()返回，在该条日志被所有接收它的落地对象写入(要求同步时还需同步到磁盘)后完成
+    // 异步日志器中由工作线程完成：要求同步的日志不会每条都调用flush()，而是攒到工作线程处理完当前缓冲区时，
+    // 对涉及的每个落地对象只调用一次flush()，再一起完成这一批日志的通知(组提交)
+    // 可以通过wait()阻塞等待，也可以通过on_complete()注册回调，以C++20编译时还可以在协程中直接co_await；
+    // 同一个完成通知可以注册多个回调、被多个协程co_await，完成时先按注册顺序执行回调，再按挂起顺序恢复协程
+    // 注意：回调和被co_await挂起的协程都在完成通知的线程(通常是异步工作线程)中执行，其中不应长时间阻塞，需要时应自行转交给其他线程
+    class LogCompletion
+    {
+    public:
+        using ptr = std::shared_ptr<LogCompletion>;
+        using callback_t = std::function<void(bool)>;
+        // pending为需要等待的落地对象数量，为0时直接处于完成状态；sync为true表示完成前需要将日志同步到磁盘
+        LogCompletion(size_t pending, bool sync) : _pending(pending), _sync(sync), _done(pending == 0) {}
+        // 是否已经完成
+        bool done() const { return _done.load(std::memory_order_acquire); }
+        // 是否所有落地对象都成功写入(和同步)，只有完成后才有意义
+        bool ok() const { return _ok.load(std::memory_order_acquire); }
+        // 完成前是否需要将日志同步到磁盘
+        bool sync() const { return _sync; }
+        // 阻塞等待直到完成，返回ok()
+        bool wait()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond.wait(lock, [&]()
+                       { return done(); });
+            return ok();
+        }
+        // 注册完成时执行的回调，参数为ok()；已经完成时直接在调用线程中执行
+        void on_complete(callback_t callback)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (!done())
+                {
+                    _callbacks.push_back(std::move(callback));
+                    return;
+                }
+            }
+            callback(ok());
+        }
+        // 一个落地对象的写入(和同步)已经结束，ok为其结果，所有落地对象都结束后完成
+        void finish(bool ok)
+        {
+            if (!ok)
+                _ok.store(false, std::memory_order_release);
+            if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                complete();
+        }
+        // 日志在交给任何落地对象之前就已失败(如格式化失败)时，直接以失败完成
+        void abort()
+        {
+            _ok.store(false, std::memory_order_release);
+            _pending.store(0, std::memory_order_release);
+            complete();
+        }
+#if defined(LOG_SYSTEM_HAVE_COROUTINE)
+        // co_await的等待对象，co_await的结果为ok()
+        struct Awaiter
+        {
+            LogCompletion::ptr _completion;
+            bool await_ready() const { return _completion->done(); }
+            // 返回false表示注册时已经完成，协程不挂起直接继续执行
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                std::unique_lock<std::mutex> lock(_completion->_mutex);
+                if (_completion->done())
+                    return false;
+                _completion->_handles.push_back(handle);
+                return true;
+            }
+            bool await_resume() const { return _completion->ok(); }
+        };
+#endif
+
+    private:
+        void complete()
+        {
+            std::vector<callback_t> callbacks;
+#if defined(LOG_SYSTEM_HAVE_COROUTINE)
+            std::vector<std::coroutine_handle<>> handles;
+#endif
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _done.store(true, std::memory_order_release);
+                callbacks.swap(_callbacks);
+#if defined(LOG_SYSTEM_HAVE_COROUTINE)
+                handles.swap(_handles);
+#endif
+            }
+            _cond.notify_all();
+            for (auto &callback : callbacks)
+                callback(ok());
+#if defined(LOG_SYSTEM_HAVE_COROUTINE)
+            for (auto handle : handles)
+                handle.resume();
+#endif
+        }
+
+    private:
+        std::mutex _mutex;                             // 保护_callbacks和_handles，并与_cond配合使用
+        std::condition_variable _cond;                 // wait()在该条件变量下等待完成
+        std::atomic<size_t> _pending;                  // 尚未结束写入的落地对象数量
+        std::atomic<bool> _ok{true};                   // 是否所有落地对象都写入成功
+        const bool _sync;                              // 完成前是否需要同步到磁盘
+        std::atomic<bool> _done;                       // 是否已经完成
+        std::vector<callback_t> _callbacks;            // 完成时执行的回调
+#if defined(LOG_SYSTEM_HAVE_COROUTINE)
+        std::vector<std::coroutine_handle<>> _handles; // 等待完成的协程
+#endif
+    };
+#if defined(LOG_SYSTEM_HAVE_COROUTINE)
+    // 使LogCompletion::ptr可以直接被co_await，如 bool ok = co_await LOG_DURABLE(logger, ...);
+    inline LogCompletion::Awaiter operator co_await(const LogCompletion::ptr &completion) { return LogCompletion::Awaiter{completion}; }
+#endif
+}
+
+#endif
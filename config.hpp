@@ -0,0 +1,741 @@
+#ifndef LOG_SYSTEM_CONFIG_HPP
+#define LOG_SYSTEM_CONFIG_HPP
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include "logger.hpp"
+
+namespace log_system
+{
+#define CONFIG_WATCH_INTERVAL_MS 200 // 配置文件监视线程检查停止标志的间隔
+
+    // 配置文件加载模块，根据INI格式的配置文件创建异步工作线程池、落地对象和日志器，不依赖任何第三方库
+    // 配置文件由若干小节组成，小节名为"类别:名称"，类别可以是pool、sink和logger，每行一个"键 = 值"，以'#'或';'开头的行为注释
+    /*
+        [pool:io]
+        threads = 2               工作线程数量
+        buffer_size = 4096        队列容量
+        cpus = 0-3,8              工作线程允许运行的CPU
+        nice = 0                  工作线程的nice值
+        numa = false              是否按NUMA节点划分队列
+        wake = balanced           唤醒模式 balanced/latency/cpu
+
+        [sink:app]
+        type = file               stdout/console/file/roll/ring/socket/syslog/route
+        level = INFO              该落地对象接收的最低日志等级，所有类型通用
+        path = ./logs/app.log     file/roll/ring(转储路径)/syslog(套接字路径)
+        sync = false              file/roll：每次写入后是否同步到磁盘
+        max_size = 1048576        roll：滚动文件的最大大小
+        index_format = [%L][%m]%n roll：写入该文件的日志格式，设置后每次滚动时为写满的文件建立稀疏索引，供logquery查询
+        slot_count、slot_size     ring：槽位数量和大小(slot_size不超过MAX_RING_SLOT_SIZE)
+        target = stdout           console：stdout/stderr/split
+        flush = every             console：every/full
+        color = true              console：输出到终端时是否着色
+        socket_type = unix        socket：unix/unixgram/tcp
+        address = /run/agent.sock socket：对端地址
+        batch_size、spill_size    socket：批量发送大小和待发送缓冲区上限
+        app_name、facility、batch syslog：应用名称、facility和批次大小
+        routes = DEBUG-WARN:app, ERROR-FATAL:err   route：等级范围到子落地对象(其他sink小节的名称)的路由规则
+
+        [logger:app]
+        type = async              sync/async
+        level = DEBUG             日志器的最低输出等级
+        pattern = [%L][%m]%n      输出格式，只有以'#'或';'开头的整行才是注释，值中的'#'和';'会原样保留
+        sinks = app, console      使用的落地对象(sink小节的名称)
+        pool = io                 异步日志器使用的线程池(pool小节的名称)，不指定时使用默认线程池
+        backtrace = 32            回溯环大小
+        sample.DEBUG = 100        DEBUG日志每100条输出1条，sample_random.DEBUG则改为按1/100的概率输出
+    */
+    // 加载时先解析并校验整个文件(未知的键、不合法的值、引用不存在的小节都会导致加载失败)，全部通过后才创建对象，
+    // 所有日志器最后通过LoggerManager::replace_loggers()一次性替换，加载失败时已有的配置保持不变：
+    // 创建对象时可能失败的情况(如地址无法解析、环形内存数量超限)都在校验阶段检查，复用的落地对象的等级等设置在所有对象都创建成功后才修改，
+    // 万一仍有创建失败，本次新建的线程池也会被移除；上一次加载的配置中存在、本次配置中已删除的日志器会被移除
+    // watch()通过inotify监视配置文件，文件被修改或替换后自动重新加载；重新加载时同名线程池和落地对象会被复用，线程池的参数不会改变
+    class Config
+    {
+    public:
+        // 加载配置文件，成功返回true，失败返回false并可通过last_error()获取原因
+        static bool load(const std::string &path)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::ifstream ifs(path);
+            if (!ifs.is_open())
+                return fail("无法打开配置文件: " + path);
+            std::stringstream sstr;
+            sstr << ifs.rdbuf();
+            return load_string_locked(sstr.str());
+        }
+        // 从字符串中加载配置，格式与配置文件相同
+        static bool load_string(const std::string &content)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return load_string_locked(content);
+        }
+        // 获取最近一次加载失败的原因
+        static std::string last_error()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _error;
+        }
+        // 先加载一次配置文件，再启动监视线程，配置文件发生变化时自动重新加载；加载失败或已经在监视时返回false
+        static bool watch(const std::string &path)
+        {
+            if (!load(path))
+                return false;
+            std::unique_lock<std::mutex> lock(_watch_mutex);
+            if (_watch_thread.joinable())
+                return false;
+            std::string dir = Util::file_dir(path), fname = Util::get_fname(path);
+            if (dir == "" || fname == "")
+                return false;
+            int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (fd == -1)
+                return false;
+            // 监视所在目录而不是文件本身，编辑器保存时常以重命名的方式替换文件
+            if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) == -1)
+            {
+                close(fd);
+                return false;
+            }
+            _watch_stop.store(false);
+            _watch_thread = std::thread(watch_thread, fd, path, fname);
+            return true;
+        }
+        // 停止监视线程
+        static void stop_watch()
+        {
+            std::unique_lock<std::mutex> lock(_watch_mutex);
+            if (!_watch_thread.joinable())
+                return;
+            _watch_stop.store(true);
+            _watch_thread.join();
+        }
+
+    private:
+        // 解析后的一个小节
+        struct Section
+        {
+            std::string _kind;                          // 类别：pool/sink/logger
+            std::string _name;                          // 名称
+            std::map<std::string, std::string> _values; // 所有的键值对
+            size_t _line;                               // 小节所在的行号
+        };
+        // 停止监视线程并释放资源，程序退出时自动调用
+        struct WatchGuard
+        {
+            ~WatchGuard() { stop_watch(); }
+        };
+        static bool fail(const std::string &error)
+        {
+            _error = error;
+            return false;
+        }
+        static std::string trim(const std::string &str)
+        {
+            size_t l = str.find_first_not_of(" \t\r\n"), r = str.find_last_not_of(" \t\r\n");
+            return l == std::string::npos ? "" : str.substr(l, r - l + 1);
+        }
+        static std::vector<std::string> split(const std::string &str, char sep)
+        {
+            std::vector<std::string> ret;
+            std::stringstream sstr(str);
+            std::string item;
+            while (std::getline(sstr, item, sep))
+            {
+                item = trim(item);
+                if (!item.empty())
+                    ret.push_back(item);
+            }
+            return ret;
+        }
+        // 将配置内容解析为小节数组，只检查语法
+        static bool parse(const std::string &content, std::vector<Section> &sections)
+        {
+            std::stringstream sstr(content);
+            std::string line;
+            size_t lineno = 0;
+            std::set<std::string> names;
+            while (std::getline(sstr, line))
+            {
+                lineno++;
+                line = trim(line);
+                if (line.empty() || line[0] == '#' || line[0] == ';')
+                    continue;
+                std::string where = "第" + std::to_string(lineno) + "行: ";
+                if (line[0] == '[')
+                {
+                    size_t colon = line.find(':');
+                    if (line.back() != ']' || colon == std::string::npos)
+                        return fail(where + "小节名应为[类别:名称]");
+                    Section sec;
+                    sec._kind = trim(line.substr(1, colon - 1));
+                    sec._name = trim(line.substr(colon + 1, line.size() - colon - 2));
+                    sec._line = lineno;
+                    if (sec._kind != "pool" && sec._kind != "sink" && sec._kind != "logger")
+                        return fail(where + "未知的小节类别: " + sec._kind);
+                    if (sec._name.empty() || !names.insert(sec._kind + ":" + sec._name).second)
+                        return fail(where + "小节名称为空或重复: " + sec._name);
+                    sections.push_back(sec);
+                    continue;
+                }
+                size_t eq = line.find('=');
+                if (eq == std::string::npos || sections.empty())
+                    return fail(where + "应为小节内的\"键 = 值\"");
+                std::string key = trim(line.substr(0, eq));
+                if (key.empty() || sections.back()._values.count(key))
+                    return fail(where + "键为空或重复: " + key);
+                sections.back()._values[key] = trim(line.substr(eq + 1));
+            }
+            return true;
+        }
+        static bool parse_level(const std::string &str, Level::value &val)
+        {
+            const Level::value levels[] = {Level::value::DEBUG, Level::value::INFO, Level::value::WARN,
+                                           Level::value::ERROR, Level::value::FATAL, Level::value::OFF};
+            for (auto level : levels)
+            {
+                if (str == (level == Level::value::OFF ? "OFF" : Level::to_string(level)))
+                {
+                    val = level;
+                    return true;
+                }
+            }
+            return false;
+        }
+        static bool parse_size(const std::string &str, size_t &val)
+        {
+            if (str.empty() || str[0] == '-')
+                return false;
+            char *end;
+            val = strtoull(str.c_str(), &end, 10);
+            return *end == '\0';
+        }
+        static bool parse_int(const std::string &str, int &val)
+        {
+            char *end;
+            val = (int)strtol(str.c_str(), &end, 10);
+            return !str.empty() && *end == '\0';
+        }
+        static bool parse_bool(const std::string &str, bool &val)
+        {
+            if (str == "true" || str == "1" || str == "yes" || str == "on")
+                val = true;
+            else if (str == "false" || str == "0" || str == "no" || str == "off")
+                val = false;
+            else
+                return false;
+            return true;
+        }
+        // 取出sec中键为key的值，不存在时使用默认值def，required为true时键必须存在
+        static bool get(const Section &sec, const std::string &key, std::string &val, const std::string &def = "", bool required = false)
+        {
+            auto it = sec._values.find(key);
+            if (it == sec._values.end())
+            {
+                val = def;
+                return required ? fail(where(sec) + "缺少" + key) : true;
+            }
+            val = it->second;
+            return true;
+        }
+        static std::string where(const Section &sec)
+        {
+            return "第" + std::to_string(sec._line) + "行[" + sec._kind + ":" + sec._name + "]: ";
+        }
+        // 检查sec中只包含allowed中的键(以"sample."、"sample_random."开头的键由调用者另行检查)
+        static bool check_keys(const Section &sec, const std::set<std::string> &allowed)
+        {
+            for (auto &kv : sec._values)
+            {
+                if (allowed.count(kv.first) == 0)
+                    return fail(where(sec) + "未知的键: " + kv.first);
+            }
+            return true;
+        }
+        // 校验pool小节并生成线程池配置
+        static bool build_pool(const Section &sec, AsynPoolConfig &config)
+        {
+            if (!check_keys(sec, {"threads", "buffer_size", "cpus", "nice", "numa", "wake"}))
+                return false;
+            std::string val;
+            get(sec, "threads", val, std::to_string(DEFAULT_ASYN_THREAD_SIZE));
+            if (!parse_size(val, config._thread_size) || config._thread_size == 0)
+                return fail(where(sec) + "threads不合法: " + val);
+            get(sec, "buffer_size", val, std::to_string(BUFFER_SIZE));
+            if (!parse_size(val, config._buffer_size) || config._buffer_size == 0)
+                return fail(where(sec) + "buffer_size不合法: " + val);
+            get(sec, "cpus", val);
+            if (!Util::parse_cpulist(val, config._cpus))
+                return fail(where(sec) + "cpus不合法: " + val);
+            get(sec, "nice", val, "0");
+            if (!parse_int(val, config._nice) || config._nice < -20 || config._nice > 19)
+                return fail(where(sec) + "nice不合法: " + val);
+            get(sec, "numa", val, "false");
+            if (!parse_bool(val, config._numa))
+                return fail(where(sec) + "numa不合法: " + val);
+            get(sec, "wake", val, "balanced");
+            if (val != "balanced" && val != "latency" && val != "cpu")
+                return fail(where(sec) + "wake不合法: " + val);
+            config.set_wake_mode(val == "latency" ? WAKE_LATENCY : (val == "cpu" ? WAKE_CPU : WAKE_BALANCED));
+            return true;
+        }
+        // 校验sink小节，只检查参数是否合法，不创建落地对象
+        static bool check_sink(const Section &sec, const std::map<std::string, const Section *> &sinks)
+        {
+            std::string type, val;
+            if (!get(sec, "type", type, "", true))
+                return false;
+            std::set<std::string> keys = {"type", "level"};
+            if (type == "stdout")
+                ;
+            else if (type == "console")
+                keys.insert({"target", "flush", "color"});
+            else if (type == "file")
+                keys.insert({"path", "sync"});
+            else if (type == "roll")
+                keys.insert({"path", "sync", "max_size", "index_format"});
+            else if (type == "ring")
+                keys.insert({"path", "slot_count", "slot_size"});
+            else if (type == "socket")
+                keys.insert({"socket_type", "address", "batch_size", "spill_size"});
+            else if (type == "syslog")
+                keys.insert({"path", "app_name", "facility", "batch"});
+            else if (type == "route")
+                keys.insert("routes");
+            else
+                return fail(where(sec) + "未知的落地类型: " + type);
+            if (!check_keys(sec, keys))
+                return false;
+            Level::value level;
+            if (get(sec, "level", val, "DEBUG") && !parse_level(val, level))
+                return fail(where(sec) + "level不合法: " + val);
+            if ((type == "file" || type == "roll" || type == "ring") && !get(sec, "path", val, "", true))
+                return false;
+            if ((type == "file" || type == "roll" || type == "ring") && Util::path_transform(val) == "")
+                return fail(where(sec) + "path不合法: " + val);
+            if (type == "roll" && Util::get_fname(Util::path_transform(val)) == "")
+                return fail(where(sec) + "path不合法: " + val);
+            // 转储目录在创建环形内存时创建，提前创建以便在修改任何配置之前发现无法创建的目录
+            if (type == "ring" && !Util::create_dir(Util::file_dir(Util::path_transform(val))))
+                return fail(where(sec) + "无法创建转储目录: " + val);
+            if (get(sec, "index_format", val) && val != "" && !LogFmt(val).is_line_format())
+                return fail(where(sec) + "index_format必须以换行结尾且只在结尾处换行: " + val);
+            bool b;
+            size_t n;
+            for (auto key : {"sync", "color"})
+            {
+                if (get(sec, key, val, "true") && !parse_bool(val, b))
+                    return fail(where(sec) + key + "不合法: " + val);
+            }
+            for (auto key : {"max_size", "slot_count", "slot_size", "batch_size", "spill_size", "batch"})
+            {
+                if (get(sec, key, val, "1") && (!parse_size(val, n) || (n == 0 && strcmp(key, "batch_size") != 0)))
+                    return fail(where(sec) + key + "不合法: " + val);
+            }
+            if (get(sec, "slot_size", val, "1") && parse_size(val, n) && n > MAX_RING_SLOT_SIZE)
+                return fail(where(sec) + "slot_size不能超过" + std::to_string(MAX_RING_SLOT_SIZE) + ": " + val);
+            if (get(sec, "target", val, "stdout") && val != "stdout" && val != "stderr" && val != "split")
+                return fail(where(sec) + "target不合法: " + val);
+            if (get(sec, "flush", val, "every") && val != "every" && val != "full")
+                return fail(where(sec) + "flush不合法: " + val);
+            int facility;
+            if (get(sec, "facility", val, "1") && (!parse_int(val, facility) || facility < 0 || facility > 23))
+                return fail(where(sec) + "facility不合法: " + val);
+            if (type == "socket")
+            {
+                if (!get(sec, "address", val, "", true))
+                    return false;
+                std::string address = val;
+                if (get(sec, "socket_type", val, "unix") && val != "unix" && val != "unixgram" && val != "tcp")
+                    return fail(where(sec) + "socket_type不合法: " + val);
+                struct sockaddr_storage addr;
+                socklen_t addr_len;
+                if (!SocketSink::resolve(val == "tcp" ? SOCKET_TCP : (val == "unixgram" ? SOCKET_UNIX_DGRAM : SOCKET_UNIX_STREAM), address, addr, addr_len))
+                    return fail(where(sec) + "address不合法或无法解析: " + address);
+            }
+            if (type == "syslog" && get(sec, "path", val, DEFAULT_SYSLOG_PATH) &&
+                (val.empty() || val.size() >= sizeof(((struct sockaddr_un *)nullptr)->sun_path)))
+                return fail(where(sec) + "path不合法: " + val);
+            if (type == "route")
+            {
+                std::vector<LevelRouteSink::Route> routes;
+                std::vector<std::string> targets;
+                if (!get(sec, "routes", val, "", true) || !parse_routes(sec, val, routes, targets))
+                    return false;
+                for (auto &target : targets)
+                {
+                    auto it = sinks.find(target);
+                    if (it == sinks.end() || it->second == &sec)
+                        return fail(where(sec) + "路由引用了不存在的落地对象: " + target);
+                    std::string sub_type;
+                    get(*it->second, "type", sub_type);
+                    if (sub_type == "route")
+                        return fail(where(sec) + "路由的子落地对象不能是route类型: " + target);
+                }
+            }
+            return true;
+        }
+        // 解析"DEBUG-WARN:a, ERROR-FATAL:b"形式的路由规则，子落地对象暂时留空，名称按顺序放入targets
+        static bool parse_routes(const Section &sec, const std::string &str, std::vector<LevelRouteSink::Route> &routes,
+                                 std::vector<std::string> &targets)
+        {
+            for (auto &item : split(str, ','))
+            {
+                size_t colon = item.find(':'), dash = item.find('-');
+                if (colon == std::string::npos)
+                    return fail(where(sec) + "路由规则应为\"等级-等级:落地对象\": " + item);
+                std::string range = item.substr(0, colon);
+                LevelRouteSink::Route route;
+                if (!parse_level(trim(range.substr(0, dash)), route._min_level) ||
+                    !parse_level(trim(dash == std::string::npos ? range : range.substr(dash + 1)), route._max_level) ||
+                    route._min_level > route._max_level)
+                    return fail(where(sec) + "路由规则的等级范围不合法: " + item);
+                routes.push_back(route);
+                targets.push_back(trim(item.substr(colon + 1)));
+            }
+            if (routes.empty())
+                return fail(where(sec) + "routes为空");
+            return true;
+        }
+        // 校验logger小节
+        static bool check_logger(const Section &sec, const std::map<std::string, const Section *> &sinks,
+                                 const std::set<std::string> &pools)
+        {
+            std::set<std::string> keys = {"type", "level", "pattern", "sinks", "pool", "backtrace"};
+            for (int i = Level::value::DEBUG; i < Level::value::OFF; i++)
+            {
+                keys.insert("sample." + Level::to_string((Level::value)i));
+                keys.insert("sample_random." + Level::to_string((Level::value)i));
+            }
+            if (!check_keys(sec, keys))
+                return false;
+            std::string val;
+            Level::value level;
+            size_t n;
+            if (get(sec, "type", val, "sync") && val != "sync" && val != "async")
+                return fail(where(sec) + "type不合法: " + val);
+            bool async = val == "async";
+            if (get(sec, "level", val, "DEBUG") && !parse_level(val, level))
+                return fail(where(sec) + "level不合法: " + val);
+            if (get(sec, "pattern", val, DEFAULT_FMT_STR) && !LogFmt(val).is_valid())
+                return fail(where(sec) + "pattern不合法: " + val);
+            if (get(sec, "backtrace", val, "0") && !parse_size(val, n))
+                return fail(where(sec) + "backtrace不合法: " + val);
+            if (!get(sec, "sinks", val, "", true))
+                return false;
+            for (auto &name : split(val, ','))
+            {
+                if (sinks.find(name) == sinks.end())
+                    return fail(where(sec) + "引用了不存在的落地对象: " + name);
+            }
+            if (get(sec, "pool", val) && val != "")
+            {
+                if (!async)
+                    return fail(where(sec) + "只有异步日志器才能指定pool");
+                if (pools.count(val) == 0 && AsynWorkerPool::get_pool(val) == nullptr)
+                    return fail(where(sec) + "引用了不存在的线程池: " + val);
+            }
+            for (auto &kv : sec._values)
+            {
+                if (kv.first.compare(0, 7, "sample.") != 0 && kv.first.compare(0, 14, "sample_random.") != 0)
+                    continue;
+                if (!parse_size(kv.second, n))
+                    return fail(where(sec) + kv.first + "不合法: " + kv.second);
+            }
+            return true;
+        }
+        // 根据校验通过的sink小节创建落地对象，等级等设置不直接修改，而是放入settings，在所有对象都创建成功后再执行
+        // 落地对象是全局唯一的，重新加载时可能被正在使用的日志器共享，提前修改会使加载失败时已有的配置被改变
+        static LogSink::ptr create_sink(const Section &sec, const std::map<std::string, LogSink::ptr> &created,
+                                        std::vector<std::function<void()>> &settings)
+        {
+            std::string type, val;
+            size_t a, b;
+            bool flag;
+            get(sec, "type", type);
+            LogSink::ptr sink;
+            if (type == "stdout")
+                sink = StdoutSink::get_sink();
+            else if (type == "console")
+            {
+                get(sec, "target", val, "stdout");
+                ConsoleTarget target = val == "stderr" ? CONSOLE_STDERR : (val == "split" ? CONSOLE_SPLIT : CONSOLE_STDOUT);
+                get(sec, "flush", val, "every");
+                ConsoleFlushPolicy policy = val == "full" ? FLUSH_WHEN_FULL : FLUSH_EVERY_RECORD;
+                get(sec, "color", val, "true");
+                parse_bool(val, flag);
+                sink = ConsoleSink::get_sink(target, policy, flag);
+            }
+            else if (type == "file" || type == "roll")
+            {
+                get(sec, "path", val);
+                FileSink::ptr file;
+                if (type == "file")
+                    file = FileSink::get_sink(val);
+                else
+                {
+                    std::string size, index_fmt;
+                    get(sec, "max_size", size, std::to_string(DEFAULT_MAX_SIZE));
+                    get(sec, "index_format", index_fmt);
+                    parse_size(size, a);
+                    auto roll = RollFileSinkBySize::get_sink(val, a);
+                    if (roll != nullptr)
+                        settings.push_back([roll, index_fmt]()
+                                           { roll->set_index_format(index_fmt); });
+                    file = roll;
+                }
+                get(sec, "sync", val, "false");
+                parse_bool(val, flag);
+                if (file != nullptr)
+                    settings.push_back([file, flag]()
+                                       { file->set_sync(flag); });
+                sink = file;
+            }
+            else if (type == "ring")
+            {
+                get(sec, "slot_count", val, std::to_string(DEFAULT_RING_SLOT_COUNT));
+                parse_size(val, a);
+                get(sec, "slot_size", val, std::to_string(DEFAULT_RING_SLOT_SIZE));
+                parse_size(val, b);
+                get(sec, "path", val);
+                sink = RingBufferSink::get_sink(val, a, b);
+            }
+            else if (type == "socket")
+            {
+                get(sec, "socket_type", val, "unix");
+                SocketType socket_type = val == "tcp" ? SOCKET_TCP : (val == "unixgram" ? SOCKET_UNIX_DGRAM : SOCKET_UNIX_STREAM);
+                get(sec, "batch_size", val, std::to_string(DEFAULT_SOCKET_BATCH_SIZE));
+                parse_size(val, a);
+                get(sec, "spill_size", val, std::to_string(DEFAULT_SOCKET_SPILL_SIZE));
+                parse_size(val, b);
+                get(sec, "address", val);
+                sink = SocketSink::get_sink(socket_type, val, a, b);
+            }
+            else if (type == "syslog")
+            {
+                std::string app_name, path;
+                int facility;
+                get(sec, "app_name", app_name);
+                get(sec, "facility", val, std::to_string(DEFAULT_SYSLOG_FACILITY));
+                parse_int(val, facility);
+                get(sec, "batch", val, std::to_string(DEFAULT_SYSLOG_BATCH));
+                parse_size(val, a);
+                get(sec, "path", path, DEFAULT_SYSLOG_PATH);
+                sink = SyslogSink::get_sink(app_name, facility, path, a);
+            }
+            else if (type == "route")
+            {
+                std::vector<LevelRouteSink::Route> routes;
+                std::vector<std::string> targets;
+                get(sec, "routes", val);
+                parse_routes(sec, val, routes, targets);
+                for (size_t i = 0; i < routes.size(); i++)
+                    routes[i]._sink = created.at(targets[i]);
+                sink = LevelRouteSink::get_sink(routes);
+            }
+            if (sink == nullptr)
+            {
+                fail(where(sec) + "创建落地对象失败");
+                return sink;
+            }
+            // 没有配置level时恢复为DEBUG，使重新加载时删除level能够生效；路由落地对象每次都新建，保留其根据路由规则计算出的等级
+            Level::value level = Level::value::DEBUG;
+            get(sec, "level", val, "");
+            if (val != "" || type != "route")
+            {
+                parse_level(val, level);
+                settings.push_back([sink, level]()
+                                   { sink->set_level(level); });
+            }
+            return sink;
+        }
+        // 根据校验通过的logger小节创建日志器
+        static Logger::ptr create_logger(const Section &sec, const std::map<std::string, LogSink::ptr> &created)
+        {
+            std::string type, val, pattern, pool;
+            Level::value level;
+            size_t n = 0;
+            get(sec, "type", type, "sync");
+            get(sec, "level", val, "DEBUG");
+            parse_level(val, level);
+            get(sec, "pattern", pattern, DEFAULT_FMT_STR);
+            get(sec, "pool", pool);
+            get(sec, "sinks", val);
+            std::vector<LogSink::ptr> sinks;
+            for (auto &name : split(val, ','))
+                sinks.push_back(created.at(name));
+            Logger::ptr logger = LoggerManager::get_instance()->create_logger(sec._name, type == "async" ? ASYNC_LOGGER : SYNC_LOGGER,
+                                                                              sinks, level, pattern, pool);
+            if (logger == nullptr)
+            {
+                fail(where(sec) + "创建日志器失败");
+                return logger;
+            }
+            get(sec, "backtrace", val, "0");
+            parse_size(val, n);
+            logger->enable_backtrace(n);
+            for (auto &kv : sec._values)
+            {
+                bool random = kv.first.compare(0, 14, "sample_random.") == 0;
+                if (!random && kv.first.compare(0, 7, "sample.") != 0)
+                    continue;
+                parse_level(kv.first.substr(kv.first.find('.') + 1), level);
+                parse_size(kv.second, n);
+                logger->set_sample_rate(level, n, random);
+            }
+            return logger;
+        }
+        static bool load_string_locked(const std::string &content)
+        {
+            // 第一步：解析并校验所有小节，期间不创建任何对象
+            std::vector<Section> sections;
+            if (!parse(content, sections))
+                return false;
+            std::map<std::string, AsynPoolConfig> pools;
+            std::map<std::string, const Section *> sinks;
+            std::set<std::string> pool_names;
+            for (auto &sec : sections)
+            {
+                if (sec._kind == "pool")
+                {
+                    if (sec._name == "default")
+                        return fail(where(sec) + "不能配置默认线程池default");
+                    if (!build_pool(sec, pools[sec._name]))
+                        return false;
+                    pool_names.insert(sec._name);
+                }
+                else if (sec._kind == "sink")
+                    sinks[sec._name] = &sec;
+            }
+            std::set<std::string> new_rings;
+            for (auto &sec : sections)
+            {
+                if (sec._kind == "sink" && !check_sink(sec, sinks))
+                    return false;
+                if (sec._kind == "logger" && !check_logger(sec, sinks, pool_names))
+                    return false;
+                std::string val;
+                if (sec._kind == "sink" && get(sec, "type", val) && val == "ring" && get(sec, "path", val) &&
+                    !RingBufferSink::exists(Util::path_transform(val)))
+                    new_rings.insert(Util::path_transform(val));
+            }
+            if (new_rings.size() > RingBufferSink::available())
+                return fail("环形内存落地对象的数量超过上限" + std::to_string(MAX_CRASH_RING_SINKS));
+            // 第二步：创建线程池和落地对象，已存在的同名线程池和同一位置的落地对象会被直接复用
+            std::vector<std::string> new_pools;
+            for (auto &pool : pools)
+            {
+                if (AsynWorkerPool::get_pool(pool.first) != nullptr)
+                    continue;
+                if (!LoggerManager::get_instance()->add_pool(pool.first, pool.second))
+                    return abort_load(new_pools, "创建线程池失败: " + pool.first);
+                new_pools.push_back(pool.first);
+            }
+            std::map<std::string, LogSink::ptr> created;
+            std::vector<std::function<void()>> settings;
+            for (int pass = 0; pass < 2; pass++) // 路由落地对象依赖其他落地对象，放在第二轮创建
+            {
+                for (auto &it : sinks)
+                {
+                    std::string type;
+                    get(*it.second, "type", type);
+                    if ((type == "route") != (pass == 1))
+                        continue;
+                    LogSink::ptr sink = create_sink(*it.second, created, settings);
+                    if (sink == nullptr)
+                        return abort_load(new_pools, _error);
+                    created[it.first] = sink;
+                }
+            }
+            // 第三步：创建所有日志器，全部成功后再修改落地对象的设置并一次性替换日志器
+            std::vector<Logger::ptr> loggers;
+            std::set<std::string> names;
+            for (auto &sec : sections)
+            {
+                if (sec._kind != "logger")
+                    continue;
+                Logger::ptr logger = create_logger(sec, created);
+                if (logger == nullptr)
+                    return abort_load(new_pools, _error);
+                loggers.push_back(logger);
+                names.insert(sec._name);
+            }
+            for (auto &setting : settings)
+                setting();
+            std::vector<std::string> removed;
+            for (auto &name : _loggers)
+            {
+                if (names.count(name) == 0)
+                    removed.push_back(name);
+            }
+            LoggerManager::get_instance()->replace_loggers(loggers, removed);
+            _loggers = names;
+            _error.clear();
+            return true;
+        }
+        // 加载失败时移除本次新建的线程池，已有的配置保持不变
+        static bool abort_load(const std::vector<std::string> &new_pools, const std::string &error)
+        {
+            for (auto &name : new_pools)
+                AsynWorkerPool::remove_pool(name);
+            return fail(error);
+        }
+        // 监视线程的运行函数，fd为监视配置文件所在目录的inotify文件描述符
+        static void watch_thread(int fd, std::string path, std::string fname)
+        {
+            char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            while (!_watch_stop.load())
+            {
+                struct pollfd pfd = {fd, POLLIN, 0};
+                if (poll(&pfd, 1, CONFIG_WATCH_INTERVAL_MS) <= 0)
+                    continue;
+                bool changed = false;
+                ssize_t len;
+                while ((len = read(fd, buf, sizeof(buf))) > 0)
+                {
+                    for (char *p = buf; p < buf + len;)
+                    {
+                        struct inotify_event *event = (struct inotify_event *)p;
+                        if (event->len > 0 && fname == event->name)
+                            changed = true;
+                        p += sizeof(struct inotify_event) + event->len;
+                    }
+                }
+                if (changed)
+                    load(path); // 加载失败时保留原有配置，失败原因可通过last_error()获取
+            }
+            close(fd);
+        }
+
+    private:
+        static std::mutex _mutex;              // 保证同一时间只有一个线程在加载配置，同时保护_error
+        static std::string _error;             // 最近一次加载失败的原因
+        static std::set<std::string> _loggers; // 上一次成功加载的配置中的日志器名称，受_mutex保护
+        static std::mutex _watch_mutex;        // 保护监视线程的启动和停止
+        static std::thread _watch_thread;      // 监视线程
+        static std::atomic<bool> _watch_stop;  // 监视线程的停止标志
+        static WatchGuard _watch_guard;        // 程序退出时停止监视线程
+    };
+    std::mutex Config::_mutex;
+    std::string Config::_error;
+    std::set<std::string> Config::_loggers;
+    std::mutex Config::_watch_mutex;
+    std::thread Config::_watch_thread;
+    std::atomic<bool> Config::_watch_stop(false);
+    Config::WatchGuard Config::_watch_guard;
+}
+
+#endif
@@ -1,164 +1,459 @@
 #ifndef LOG_SYSTEM_FORMATER_HPP
 #define LOG_SYSTEM_FORMATER_HPP
 
-#include <sstream>
 #include <memory>
 #include <thread>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <time.h>
+#include <stdio.h>
 #include "level.hpp"
+#include "util.hpp"
+#include "simd.hpp"
 
 namespace log_system
 {
     // 日志消息类。包含一条日志中所需的所有内容
+    // 文件名、日志器名称和日志主体消息都只是引用调用者持有的数据，不进行拷贝，因此LogMsg只在格式化期间有效
     struct LogMsg
     {
         using ptr = std::shared_ptr<LogMsg>;
         LogMsg() = default;
-        LogMsg(const std::string &filename, size_t line, time_t time,
-               std::thread::id tid, const std::string &logggername,
-               const std::string &main_message, Level::value level)
-            : _filename(filename), _line(line), _time(time), _tid(tid),
-              _logggername(logggername), _main_message(main_message), _level(level) {}
+        LogMsg(std::string_view filename, size_t line, time_t time,
+               const Util::ThreadInfo *thread, std::string_view logggername,
+               std::string_view main_message, Level::value level, size_t sample_rate = 1)
+            : _filename(filename), _line(line), _time(time), _thread(thread),
+              _logggername(logggername), _main_message(main_message), _level(level), _sample_rate(sample_rate) {}
         ~LogMsg() {}
-        std::string _filename;     // 文件名
-        size_t _line;              // 行号
-        time_t _time;              // 时间戳
-        std::thread::id _tid;      // 线程ID
-        std::string _logggername;  // 日志器名称
-        std::string _main_message; // 日志主体消息
-        Level::value _level;       // 日志等级
+        std::string_view _filename;                // 文件名
+        size_t _line;                              // 行号
+        time_t _time;                              // 时间戳
+        const Util::ThreadInfo *_thread = nullptr; // 输出日志的线程的信息(线程ID和线程名称)
+        std::string_view _logggername;             // 日志器名称
+        std::string_view _main_message;            // 日志主体消息
+        Level::value _level;                       // 日志等级
+        size_t _sample_rate = 1;                   // 该条日志所在等级的采样率(每N条输出1条)，未采样时为1，下游工具可据此还原实际的日志条数
     };
 
-    // 格式化类，构造时传入将来输出日志时的格式化的字符串样式以及一个包含日志所有信息的LogMsg对象\
-    格式化的结果放在_result中,成功则为日志输出的结果字符串，失败则为空串,用户通过get_result()接口获取结果
+    // 从一条已输出的日志中解析回的各个字段，字符串字段都只引用被解析的日志文本，格式化字符串中不包含的字段为空
+    struct LogFields
+    {
+        std::string_view _date;                  // %D 日期
+        std::string_view _time;                  // %T 时间
+        std::string_view _tid;                   // %i 线程id
+        std::string_view _thread_name;           // %I 线程名称
+        std::string_view _level_str;             // %L 日志级别
+        std::string_view _logggername;           // %N 日志器名称
+        std::string_view _filename;              // %f 文件名
+        std::string_view _line;                  // %l 行号
+        std::string_view _main_message;          // %m 日志消息
+        std::string_view _sample_rate;           // %R 采样率
+        Level::value _level = Level::value::OFF; // 由_level_str还原的日志等级，格式化字符串中不包含%L时为OFF
+        time_t _timestamp = -1;                  // 由_date和_time还原的时间戳，格式化字符串中不包含%D或%T时为-1
+    };
+
+    // 格式化类，构造时传入将来输出日志时的格式化的字符串样式，构造时就将其解析为格式化项数组，之后每条日志只需按数组依次输出
+    // 通过format()接口将一条日志格式化后追加到调用者提供的字符串中，调用者复用该字符串即可避免每条日志的内存分配
     /*
            %D 日期(年月日)
            %T 时间(时分秒)
            %t 缩进
-           %i 线程id
+           %i 线程id(操作系统线程id)
+           %I 线程名称(未设置时输出线程id)
            %L 日志级别
            %N 日志器名称
            %f 文件名
            %l 行号
            %m 日志消息
+           %M 清理后的日志消息(换行等控制字符被转义为\n、\xHH等可见形式，防止通过日志消息伪造日志)
+           %J JSON转义后的日志消息(用于"%m"位于JSON字符串中的格式，如{"msg":"%J"}%n)
+           %R 采样率(该条日志代表的实际日志条数)
            %n 换行
            %% 表示一个'%'字符
     */
     class LogFmt
     {
     public:
-        LogFmt(const std::string format_str, const LogMsg &msg)
+        LogFmt(const std::string &format_str)
         {
-            int pos = 0;
+            size_t pos = 0;
+            std::string text;
             while (pos < format_str.size())
             {
-                if (format_str[pos] == '%')
+                if (format_str[pos] != '%')
                 {
-                    if (pos + 1 >= format_str.size())
-                    {
-                        _result = "";
-                        return;
-                    }
-                    switch (format_str[pos + 1])
-                    {
-                    case 'D':
-                        _result += data_to_string(msg);
-                        break;
-                    case 'T':
-                        _result += time_to_string(msg);
-                        break;
-                    case 't':
-                        _result += '\t';
-                        break;
-                    case 'i':
-                        _result += tid_to_string(msg);
-                        break;
-                    case 'L':
-                        _result += level_to_string(msg);
-                        break;
-                    case 'N':
-                        _result += logger_name_to_string(msg);
-                        break;
-                    case 'f':
-                        _result += filename_to_string(msg);
-                        break;
-                    case 'l':
-                        _result += line_to_string(msg);
-                        break;
-                    case 'm':
-                        _result += message_to_string(msg);
-                        break;
-                    case 'n':
-                        _result += '\n';
-                        break;
-                    case '%':
-                        _result += '%';
-                        break;
-                    default:
-                        _result = "";
-                        return;
-                    }
-                    pos += 2;
+                    text += format_str[pos++];
+                    continue;
+                }
+                if (pos + 1 >= format_str.size())
+                {
+                    _valid = false;
+                    return;
+                }
+                char type = format_str[pos + 1];
+                pos += 2;
+                switch (type)
+                {
+                case 't':
+                    text += '\t';
+                    continue;
+                case 'n':
+                    text += '\n';
+                    continue;
+                case '%':
+                    text += '%';
+                    continue;
+                case 'D':
+                case 'T':
+                case 'i':
+                case 'I':
+                case 'L':
+                case 'N':
+                case 'f':
+                case 'l':
+                case 'm':
+                case 'M':
+                case 'J':
+                case 'R':
+                    break;
+                default:
+                    _valid = false;
+                    return;
+                }
+                if (!text.empty())
+                    _items.push_back(Item{TEXT_ITEM, text});
+                text.clear();
+                _items.push_back(Item{type, ""});
+            }
+            if (!text.empty())
+                _items.push_back(Item{TEXT_ITEM, text});
+        }
+        // 格式化字符串是否合法
+        bool is_valid() const { return _valid; }
+        // 格式化字符串是否以换行结尾且只在结尾处换行，即每条日志恰好占一行，只有这样的格式输出的文件才能按行切分并解析回日志
+        bool is_line_format() const
+        {
+            if (!_valid || _items.empty() || _items.back()._type != TEXT_ITEM)
+                return false;
+            for (size_t i = 0; i < _items.size(); i++)
+            {
+                if (_items[i]._type != TEXT_ITEM)
+                    continue;
+                size_t pos = _items[i]._text.find('\n');
+                if (pos != std::string::npos && (i + 1 != _items.size() || pos + 1 != _items[i]._text.size()))
+                    return false;
+            }
+            return true;
+        }
+        // 将str转义后追加到out的末尾，json为false时将控制字符转义为\n、\r、\t或\xHH，json为true时按JSON字符串的规则转义
+        // 先用find找到下一个需要转义的字节，其前面不需要转义的部分整段追加，因此几乎不含控制字符的长消息只需极少的向量比较和一次拷贝
+        static void append_escaped(std::string &out, std::string_view str, bool json, Simd::FindEscapeFunc find = Simd::best_find_escape())
+        {
+            static const char hex[] = "0123456789abcdef";
+            size_t pos = 0;
+            while (pos < str.size())
+            {
+                size_t clean = find(str.data() + pos, str.size() - pos, json);
+                out.append(str.data() + pos, clean);
+                pos += clean;
+                if (pos == str.size())
+                    break;
+                unsigned char c = str[pos++];
+                switch (c)
+                {
+                case '\n':
+                    out += "\\n";
+                    break;
+                case '\r':
+                    out += "\\r";
+                    break;
+                case '\t':
+                    out += "\\t";
+                    break;
+                case '"':
+                    out += "\\\"";
+                    break;
+                case '\\':
+                    out += "\\\\";
+                    break;
+                default:
+                    out += json ? "\\u00" : "\\x";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xF];
+                    break;
                 }
-                else
-                    _result += format_str[pos++];
             }
         }
-        std::string get_result()
+        // format()的逆过程，按格式化字符串将一条已输出的日志record(包含结尾的换行)解析回各个字段，不匹配格式时返回false
+        // %m之后的固定文本可能也出现在日志消息中，因此%m从最靠后的候选位置开始尝试；相邻且没有分隔文本的字段按字符类别(数字、大写字母等)切分
+        bool parse(std::string_view record, LogFields &out) const
         {
-            return _result;
+            if (!_valid)
+                return false;
+            out = LogFields();
+            if (!parse_from(0, record, 0, out))
+                return false;
+            if (!out._level_str.empty())
+            {
+                for (int i = Level::value::DEBUG; i < Level::value::OFF; i++)
+                {
+                    if (out._level_str == Level::to_string((Level::value)i))
+                        out._level = (Level::value)i;
+                }
+            }
+            if (!out._date.empty() && !out._time.empty())
+                out._timestamp = to_timestamp(out._date, out._time);
+            return true;
+        }
+        // 将msg按格式化字符串格式化后追加到out的末尾，格式化字符串不合法时返回false
+        bool format(const LogMsg &msg, std::string &out) const
+        {
+            if (!_valid)
+                return false;
+            for (auto &item : _items)
+            {
+                switch (item._type)
+                {
+                case TEXT_ITEM:
+                    out += item._text;
+                    break;
+                case 'D':
+                    out.append(cached_time(msg._time)._date, cached_time(msg._time)._date_len);
+                    break;
+                case 'T':
+                    out.append(cached_time(msg._time)._time, cached_time(msg._time)._time_len);
+                    break;
+                case 'i':
+                    if (msg._thread != nullptr)
+                        out.append(msg._thread->_tid_str, msg._thread->_tid_len);
+                    break;
+                case 'I':
+                    if (msg._thread != nullptr && !msg._thread->_name.empty())
+                        out += msg._thread->_name;
+                    else if (msg._thread != nullptr)
+                        out.append(msg._thread->_tid_str, msg._thread->_tid_len);
+                    break;
+                case 'L':
+                    out += Level::to_string(msg._level);
+                    break;
+                case 'N':
+                    out += msg._logggername;
+                    break;
+                case 'f':
+                    out += msg._filename;
+                    break;
+                case 'l':
+                    append_number(out, msg._line);
+                    break;
+                case 'm':
+                    out += msg._main_message;
+                    break;
+                case 'M':
+                    append_escaped(out, msg._main_message, false);
+                    break;
+                case 'J':
+                    append_escaped(out, msg._main_message, true);
+                    break;
+                case 'R':
+                    append_number(out, msg._sample_rate);
+                    break;
+                }
+            }
+            return true;
         }
 
     private:
-        std::string data_to_string(const LogMsg &msg)
+        static const char TEXT_ITEM = 0; // 普通文本格式化项的类型标识
+        // 一个格式化项，_type为TEXT_ITEM时表示原样输出的文本_text，否则为格式化字符
+        struct Item
         {
-            struct tm data;
-            localtime_r(&msg._time, &data);
-            std::stringstream sstr;
-            sstr << data.tm_year + 1900 << '-';
-            sstr << data.tm_mon + 1 << '-';
-            sstr << data.tm_mday;
-            return sstr.str();
-        }
-        std::string time_to_string(const LogMsg &msg)
+            char _type;
+            std::string _text;
+        };
+        // 每个线程缓存上一次格式化时所在秒的日期和时间字符串，同一秒内的日志无需重复调用localtime_r
+        struct TimeCache
+        {
+            time_t _sec = -1;
+            char _date[32];
+            size_t _date_len = 0;
+            char _time[32];
+            size_t _time_len = 0;
+        };
+        static const TimeCache &cached_time(time_t sec)
         {
-            struct tm time;
-            localtime_r(&msg._time, &time);
-            std::stringstream sstr;
-            sstr << time.tm_hour << ':';
-            sstr << time.tm_min << ':';
-            sstr << time.tm_sec;
-            return sstr.str();
+            thread_local TimeCache cache;
+            if (cache._sec != sec)
+            {
+                struct tm t;
+                localtime_r(&sec, &t);
+                cache._date_len = snprintf(cache._date, sizeof(cache._date), "%d-%d-%d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+                cache._time_len = snprintf(cache._time, sizeof(cache._time), "%d:%d:%d", t.tm_hour, t.tm_min, t.tm_sec);
+                cache._sec = sec;
+            }
+            return cache;
         }
-        std::string tid_to_string(const LogMsg &msg)
+        // 从第k个格式化项、record的pos位置开始继续解析
+        bool parse_from(size_t k, std::string_view record, size_t pos, LogFields &out) const
         {
-            std::stringstream sstr;
-            sstr << msg._tid;
-            return sstr.str();
+            for (; k < _items.size(); k++)
+            {
+                const Item &item = _items[k];
+                if (item._type == TEXT_ITEM)
+                {
+                    if (record.compare(pos, item._text.size(), item._text) != 0)
+                        return false;
+                    pos += item._text.size();
+                    continue;
+                }
+                if (k + 1 == _items.size())
+                {
+                    set_field(item._type, record.substr(pos), out);
+                    pos = record.size();
+                    continue;
+                }
+                const Item &next = _items[k + 1];
+                if (next._type != TEXT_ITEM)
+                {
+                    size_t end = pos;
+                    while (end < record.size() && field_char(item._type, record[end]))
+                        end++;
+                    if (end == pos && item._type != 'I' && item._type != 'N')
+                        return false;
+                    set_field(item._type, record.substr(pos, end - pos), out);
+                    pos = end;
+                    continue;
+                }
+                if (item._type != 'm' && item._type != 'M' && item._type != 'J')
+                {
+                    size_t end = record.find(next._text, pos);
+                    if (end == std::string_view::npos)
+                        return false;
+                    set_field(item._type, record.substr(pos, end - pos), out);
+                    pos = end;
+                    continue;
+                }
+                // %m的结束位置从后往前尝试，直到剩余部分能够匹配之后的所有格式化项
+                size_t end = record.rfind(next._text);
+                while (end != std::string_view::npos && end >= pos)
+                {
+                    set_field(item._type, record.substr(pos, end - pos), out);
+                    if (parse_from(k + 1, record, end, out))
+                        return true;
+                    if (end == pos)
+                        break;
+                    end = record.rfind(next._text, end - 1);
+                }
+                return false;
+            }
+            return pos == record.size();
         }
-        std::string level_to_string(const LogMsg &msg)
+        // 没有分隔文本时字段可以包含的字符
+        static bool field_char(char type, char c)
         {
-            return Level::to_string(msg._level);
+            switch (type)
+            {
+            case 'D':
+                return (c >= '0' && c <= '9') || c == '-';
+            case 'T':
+                return (c >= '0' && c <= '9') || c == ':';
+            case 'i':
+            case 'l':
+            case 'R':
+                return c >= '0' && c <= '9';
+            case 'L':
+                return c >= 'A' && c <= 'Z';
+            default:
+                return false;
+            }
         }
-        std::string logger_name_to_string(const LogMsg &msg)
+        static void set_field(char type, std::string_view val, LogFields &out)
         {
-            return msg._logggername;
+            switch (type)
+            {
+            case 'D':
+                out._date = val;
+                break;
+            case 'T':
+                out._time = val;
+                break;
+            case 'i':
+                out._tid = val;
+                break;
+            case 'I':
+                out._thread_name = val;
+                break;
+            case 'L':
+                out._level_str = val;
+                break;
+            case 'N':
+                out._logggername = val;
+                break;
+            case 'f':
+                out._filename = val;
+                break;
+            case 'l':
+                out._line = val;
+                break;
+            case 'm':
+            case 'M':
+            case 'J':
+                out._main_message = val;
+                break;
+            case 'R':
+                out._sample_rate = val;
+                break;
+            }
         }
-        std::string filename_to_string(const LogMsg &msg)
+        // 从str中依次解析出count个以sep分隔的整数，失败返回false
+        static bool parse_numbers(std::string_view str, char sep, int *nums, size_t count)
         {
-            return msg._filename;
+            const char *p = str.data(), *end = str.data() + str.size();
+            for (size_t i = 0; i < count; i++)
+            {
+                auto ret = std::from_chars(p, end, nums[i]);
+                if (ret.ec != std::errc() || (i + 1 < count && (ret.ptr == end || *ret.ptr != sep)))
+                    return false;
+                p = ret.ptr + 1;
+                if (i + 1 == count && ret.ptr != end)
+                    return false;
+            }
+            return true;
         }
-        std::string line_to_string(const LogMsg &msg)
+        // 将%D和%T输出的本地时间还原为时间戳，失败返回-1
+        // 每个线程缓存上一次所在小时的起始时间戳，同一小时内的日志无需重复调用mktime()(夏令时只在整点切换，因此按小时缓存是准确的)
+        static time_t to_timestamp(std::string_view date, std::string_view time)
         {
-            return std::to_string(msg._line);
+            int d[3], t[3];
+            if (!parse_numbers(date, '-', d, 3) || !parse_numbers(time, ':', t, 3))
+                return -1;
+            thread_local int cache_key[4] = {-1, -1, -1, -1};
+            thread_local time_t cache_base = -1;
+            if (cache_key[0] != d[0] || cache_key[1] != d[1] || cache_key[2] != d[2] || cache_key[3] != t[0])
+            {
+                struct tm tm_hour = {};
+                tm_hour.tm_year = d[0] - 1900;
+                tm_hour.tm_mon = d[1] - 1;
+                tm_hour.tm_mday = d[2];
+                tm_hour.tm_hour = t[0];
+                tm_hour.tm_isdst = -1;
+                cache_base = mktime(&tm_hour);
+                cache_key[0] = d[0], cache_key[1] = d[1], cache_key[2] = d[2], cache_key[3] = t[0];
+            }
+            return cache_base == -1 ? -1 : cache_base + t[1] * 60 + t[2];
         }
-        std::string message_to_string(const LogMsg &msg)
+        static void append_number(std::string &out, size_t num)
         {
-            return msg._main_message;
+            char buf[24];
+            auto ret = std::to_chars(buf, buf + sizeof(buf), num);
+            out.append(buf, ret.ptr - buf);
         }
 
     private:
-        std::string _result;
+        std::vector<Item> _items; // 解析格式化字符串得到的格式化项数组
+        bool _valid = true;       // 格式化字符串是否合法
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -2,6 +2,8 @@
 #define LOG_SYSTEM_LOG_H
 
 #include "logger.hpp"
+#include "shm_channel.hpp"
+#include "config.hpp"
 
 namespace log_system
 {
@@ -13,19 +15,37 @@ namespace log_system
     // 根据日志器名称直接获取日志器，失败则返回nullptr
     Logger::ptr get_logger(const std::string &name) { return LoggerManager::get_instance()->get_logger(name); }
     // 根据传入的参数创建新的日志器，若日志器已经存在或者发生错误则返回false
+    // 异步日志器可通过pool_name指定使用add_pool()创建的线程池，为空则使用全局默认的线程池
     bool add_logger(const std::string &logger_name, LoggerType type = SYNC_LOGGER, const std::vector<LogSink::ptr> &sinks = {StdoutSink::get_sink()},
-                    Level::value val = Level::value::DEBUG, const std::string &fmt_str = DEFAULT_FMT_STR)
+                    Level::value val = Level::value::DEBUG, const std::string &fmt_str = DEFAULT_FMT_STR,
+                    const std::string &pool_name = "")
     {
-        return LoggerManager::get_instance()->add_logger(logger_name, type, sinks, val, fmt_str);
+        return LoggerManager::get_instance()->add_logger(logger_name, type, sinks, val, fmt_str, pool_name);
     }
+    // 根据配置创建命名的异步工作线程池，若线程池已经存在或者配置不合法则返回false
+    bool add_pool(const std::string &pool_name, const AsynPoolConfig &config)
+    {
+        return LoggerManager::get_instance()->add_pool(pool_name, config);
+    }
+    // 加载配置文件创建线程池、落地对象和日志器，watch为true时还会监视配置文件并在其变化后自动重新加载，失败返回false
+    bool load_config(const std::string &path, bool watch = false) { return watch ? Config::watch(path) : Config::load(path); }
+    // 设置当前线程的名称，之后该线程输出的日志可通过%I格式化字符输出该名称
+    void set_thread_name(const std::string &name) { Util::set_thread_name(name); }
+    // 获取所有日志器、异步工作线程池和落地对象的统计数据快照
+    MetricsSnapshot get_metrics() { return LoggerManager::get_instance()->get_metrics(); }
 // 传入日志器和日志等级以及要输出的日志主体信息的格式化字符串和参数，用传入的日志器进行日志的落地输出
-#define LOG(logger, level, msg, ...) (logger)->log(level, __FILE__, __LINE__, msg, ##__VA_ARGS__)
+// 先通过should_log()进行等级过滤和采样决策，未通过时不会对日志参数求值，直接返回1
+// logger和level通过立即调用的lambda的参数绑定，都只求值一次
+#define LOG(logger, level, msg, ...) ([&](auto &&_log_logger, log_system::Level::value _log_level) { return _log_logger->should_log(_log_level) ? _log_logger->log(_log_level, __FILE__, __LINE__, msg, ##__VA_ARGS__) : 1; }((logger), (level)))
 // 以下接口是封装的上一接口，是省略传入日志输出等级的实现
 #define LOG_DEBUG(logger, msg, ...) LOG(logger, log_system::Level::value::DEBUG, msg, ##__VA_ARGS__)
 #define LOG_INFO(logger, msg, ...) LOG(logger, log_system::Level::value::INFO, msg, ##__VA_ARGS__)
 #define LOG_WARN(logger, msg, ...) LOG(logger, log_system::Level::value::WARN, msg, ##__VA_ARGS__)
 #define LOG_ERROR(logger, msg, ...) LOG(logger, log_system::Level::value::ERROR, msg, ##__VA_ARGS__)
 #define LOG_FATAL(logger, msg, ...) LOG(logger, log_system::Level::value::FATAL, msg, ##__VA_ARGS__)
+// 输出一条需要持久化的日志，返回LogCompletion::ptr，在该日志被写入并同步到磁盘后完成，可以wait()、注册回调或co_await
+// 异步日志器中多条这样的日志由工作线程组提交，共用一次fsync()
+#define LOG_DURABLE(logger, level, msg, ...) ((logger)->log_durable(level, __FILE__, __LINE__, true, msg, ##__VA_ARGS__))
 }
 
 #endif
\ No newline at end of file
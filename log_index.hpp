@@ -0,0 +1,262 @@
+#ifndef LOG_SYSTEM_LOG_INDEX_HPP
+#define LOG_SYSTEM_LOG_INDEX_HPP
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "format_message.hpp"
+#include "util.hpp"
+
+namespace log_system
+{
+#define DEFAULT_INDEX_BLOCK_SIZE (64 * 1024) // 稀疏索引默认的块大小，每个块对应一个索引项
+#define LOG_INDEX_SUFFIX ".idx"              // 索引文件相对于日志文件追加的后缀
+#define LOG_INDEX_MAGIC "LSIDX01"            // 索引文件的魔数(包含结尾的'\0'共8字节)
+#define LOG_INDEX_UNPARSED 5                 // 块的等级位图中标记"存在无法按格式解析的行"的位(紧跟在各个日志等级之后)
+
+    // 日志文件的稀疏索引，保存在日志文件旁的同名".idx"文件中，供logquery工具按时间范围和日志等级快速定位需要扫描的部分
+    // 日志文件按行切分为约block_size字节的块(块总是在行边界处结束)，每个块记录其偏移、长度、时间范围、出现过的日志等级的位图和日志条数
+    // 索引文件内还保存了写入日志时使用的格式化字符串，查询时据此将日志解析回各个字段
+    // 文件格式：Header | 格式化字符串 | 填充到8字节对齐 | Entry数组，所有整数均为本机字节序
+    // 只有以换行结尾且只在结尾处换行的格式化字符串(见LogFmt::is_line_format())输出的日志文件才能建立索引；
+    // 无法按格式解析的行(如日志消息中包含换行时的后续行)仍然属于所在的块，但不参与时间范围的统计，并在等级位图中以LOG_INDEX_UNPARSED标记
+    class LogIndex
+    {
+    public:
+        struct Header
+        {
+            char _magic[8];         // 魔数LOG_INDEX_MAGIC
+            uint64_t _block_size;   // 建立索引时使用的块大小
+            uint64_t _indexed_size; // 已建立索引的日志文件长度，总是位于行边界
+            uint64_t _block_count;  // 索引项的数量
+            uint64_t _fmt_len;      // 格式化字符串的长度
+        };
+        struct Entry
+        {
+            uint64_t _offset;  // 块在日志文件中的偏移
+            uint64_t _length;  // 块的长度
+            int64_t _min_time; // 块中日志的最早时间戳，块中没有可解析时间的日志时为INT64_MAX
+            int64_t _max_time; // 块中日志的最晚时间戳，块中没有可解析时间的日志时为INT64_MIN
+            uint32_t _levels;  // 块中出现过的日志等级的位图，第i位对应Level::value为i的等级
+            uint32_t _records; // 块中的行数
+        };
+
+        LogIndex() = default;
+        LogIndex(const LogIndex &tp) = delete;
+        LogIndex &operator=(const LogIndex &tp) = delete;
+        ~LogIndex() { unmap(); }
+        // 获取日志文件对应的索引文件的路径
+        static std::string index_path(const std::string &log_path) { return log_path + LOG_INDEX_SUFFIX; }
+        // 为log_path建立索引或增量更新已有的索引，fmt_str为写入该日志文件时使用的格式化字符串，成功返回true
+        // 已有索引的格式化字符串和块大小与本次相同且日志文件没有被截断时，只需从最后一个块开始重新扫描新追加的部分
+        // 新索引先写入临时文件再重命名，因此正在查询的进程不会读到写了一半的索引
+        static bool build(const std::string &log_path, const std::string &fmt_str, size_t block_size = DEFAULT_INDEX_BLOCK_SIZE)
+        {
+            LogFmt fmt(fmt_str);
+            if (!fmt.is_line_format() || block_size == 0)
+                return false;
+            int fd = open(log_path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+                return false;
+            struct stat att;
+            if (fstat(fd, &att) == -1)
+            {
+                close(fd);
+                return false;
+            }
+            size_t size = att.st_size;
+            const char *data = nullptr;
+            if (size > 0)
+            {
+                void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED)
+                {
+                    close(fd);
+                    return false;
+                }
+                data = (const char *)p;
+                madvise(p, size, MADV_SEQUENTIAL);
+            }
+            close(fd);
+
+            std::vector<Entry> entries;
+            size_t offset = 0;
+            LogIndex old;
+            if (old.load(log_path) && old.fmt() == fmt_str && old._header->_block_size == block_size &&
+                old._header->_indexed_size <= size && old._header->_block_count > 0)
+            {
+                entries.assign(old._entries, old._entries + old._header->_block_count - 1);
+                offset = old._entries[old._header->_block_count - 1]._offset;
+            }
+            old.unmap();
+
+            Entry entry = new_entry(offset);
+            LogFields fields;
+            while (offset < size)
+            {
+                const char *nl = (const char *)memchr(data + offset, '\n', size - offset);
+                if (nl == nullptr)
+                    break;
+                size_t len = nl - (data + offset) + 1;
+                if (fmt.parse(std::string_view(data + offset, len), fields))
+                {
+                    // 格式中不包含%L时无法得知日志等级，按可能是任意等级处理
+                    if (fields._level != Level::value::OFF)
+                        entry._levels |= 1u << fields._level;
+                    else
+                        entry._levels |= (1u << Level::value::OFF) - 1;
+                    if (fields._timestamp != -1)
+                    {
+                        entry._min_time = fields._timestamp < entry._min_time ? fields._timestamp : entry._min_time;
+                        entry._max_time = fields._timestamp > entry._max_time ? fields._timestamp : entry._max_time;
+                    }
+                }
+                else
+                    entry._levels |= 1u << LOG_INDEX_UNPARSED;
+                entry._records++;
+                entry._length += len;
+                offset += len;
+                if (entry._length >= block_size)
+                {
+                    entries.push_back(entry);
+                    entry = new_entry(offset);
+                }
+            }
+            if (entry._length > 0)
+                entries.push_back(entry);
+            if (data != nullptr)
+                munmap((void *)data, size);
+
+            Header header;
+            memcpy(header._magic, LOG_INDEX_MAGIC, sizeof(header._magic));
+            header._block_size = block_size;
+            header._indexed_size = entries.empty() ? 0 : entries.back()._offset + entries.back()._length;
+            header._block_count = entries.size();
+            header._fmt_len = fmt_str.size();
+            std::string tmp_path = index_path(log_path) + ".tmp";
+            int out = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (out == -1)
+                return false;
+            char pad[8] = {0};
+            bool ret = Util::write_all(out, (const char *)&header, sizeof(header)) &&
+                       Util::write_all(out, fmt_str.data(), fmt_str.size()) &&
+                       Util::write_all(out, pad, entries_offset(fmt_str.size()) - sizeof(header) - fmt_str.size()) &&
+                       Util::write_all(out, (const char *)entries.data(), entries.size() * sizeof(Entry));
+            close(out);
+            if (!ret || rename(tmp_path.c_str(), index_path(log_path).c_str()) == -1)
+            {
+                unlink(tmp_path.c_str());
+                return false;
+            }
+            return true;
+        }
+        // 通过mmap()加载log_path对应的索引文件，索引不存在或已损坏时返回false
+        bool load(const std::string &log_path)
+        {
+            unmap();
+            int fd = open(index_path(log_path).c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+                return false;
+            struct stat att;
+            if (fstat(fd, &att) == -1 || (size_t)att.st_size < sizeof(Header))
+            {
+                close(fd);
+                return false;
+            }
+            void *p = mmap(nullptr, att.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (p == MAP_FAILED)
+                return false;
+            _map = p;
+            _map_size = att.st_size;
+            _header = (const Header *)p;
+            if (memcmp(_header->_magic, LOG_INDEX_MAGIC, sizeof(_header->_magic)) != 0 ||
+                _header->_fmt_len > _map_size ||
+                entries_offset(_header->_fmt_len) + _header->_block_count * sizeof(Entry) != _map_size)
+            {
+                unmap();
+                return false;
+            }
+            _entries = (const Entry *)((const char *)p + entries_offset(_header->_fmt_len));
+            // 块的时间范围不一定单调(异步日志器和多线程输出的日志在文件中只是大致按时间排序，按NUMA节点划分队列的线程池还不保证跨队列的顺序)，
+            // 因此预先计算最晚时间的前缀最大值和最早时间的后缀最小值，二者都是单调的，可以用来二分查找
+            size_t count = _header->_block_count;
+            _prefix_max.resize(count);
+            _suffix_min.resize(count);
+            for (size_t i = 0; i < count; i++)
+                _prefix_max[i] = i == 0 || _entries[i]._max_time > _prefix_max[i - 1] ? _entries[i]._max_time : _prefix_max[i - 1];
+            for (size_t i = count; i > 0; i--)
+                _suffix_min[i - 1] = i == count || _entries[i - 1]._min_time < _suffix_min[i] ? _entries[i - 1]._min_time : _suffix_min[i];
+            return true;
+        }
+        // 写入日志时使用的格式化字符串
+        std::string fmt() const { return _header == nullptr ? "" : std::string((const char *)(_header + 1), _header->_fmt_len); }
+        // 已建立索引的日志文件长度，其后的部分尚未建立索引
+        size_t indexed_size() const { return _header == nullptr ? 0 : _header->_indexed_size; }
+        size_t block_count() const { return _header == nullptr ? 0 : _header->_block_count; }
+        const Entry &entry(size_t i) const { return _entries[i]; }
+        // 二分查找可能包含[from, to]时间范围内、且出现过levels位图中任一等级的日志的块，返回这些块的下标
+        // 前面所有块的最晚时间都早于from的块和后面所有块的最早时间都晚于to的块之外的块再逐个按自身的范围和位图过滤
+        std::vector<size_t> select(int64_t from, int64_t to, uint32_t levels) const
+        {
+            std::vector<size_t> ret;
+            size_t count = block_count();
+            size_t lo = 0, hi = count;
+            while (lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                if (_prefix_max[mid] < from)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            size_t first = lo;
+            lo = first, hi = count;
+            while (lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                if (_suffix_min[mid] <= to)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            for (size_t i = first; i < lo; i++)
+            {
+                if (_entries[i]._min_time <= to && _entries[i]._max_time >= from && (_entries[i]._levels & levels) != 0)
+                    ret.push_back(i);
+            }
+            return ret;
+        }
+
+    private:
+        static Entry new_entry(size_t offset) { return Entry{offset, 0, INT64_MAX, INT64_MIN, 0, 0}; }
+        static size_t entries_offset(size_t fmt_len) { return (sizeof(Header) + fmt_len + 7) / 8 * 8; }
+        void unmap()
+        {
+            if (_map != nullptr)
+                munmap(_map, _map_size);
+            _map = nullptr;
+            _map_size = 0;
+            _header = nullptr;
+            _entries = nullptr;
+            _prefix_max.clear();
+            _suffix_min.clear();
+        }
+
+    private:
+        void *_map = nullptr;             // 索引文件的映射地址
+        size_t _map_size = 0;             // 索引文件的大小
+        const Header *_header = nullptr;  // 映射中的文件头
+        const Entry *_entries = nullptr;  // 映射中的索引项数组
+        std::vector<int64_t> _prefix_max; // _prefix_max[i]为前i+1个块的最晚时间的最大值
+        std::vector<int64_t> _suffix_min; // _suffix_min[i]为第i个块及之后所有块的最早时间的最小值
+    };
+}
+
+#endif
@@ -3,16 +3,22 @@
 
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include <stdarg.h>
 #include <stdio.h>
+#include <deque>
+#include <algorithm>
+#include <string_view>
 #include <unordered_map>
 #include "level.hpp"
 #include "format_message.hpp"
 #include "sink.hpp"
 #include "buffer.hpp"
 #include "asyn_worker.hpp"
+#include "metrics.hpp"
 
-#define MAX_MSG 4096 // 日志主体消息的最大大小
+#define MAX_MSG 4096                     // 日志主体消息的最大大小
+#define DEFAULT_BACKTRACE_MSG_RESERVE 256 // 回溯环中每条记录预先分配的日志主体消息空间大小
 
 namespace log_system
 {
@@ -24,44 +30,335 @@ namespace log_system
         ASYNC_LOGGER
     };
     // 日志器模块，作用：组合其他模块的功能，最终供用户调用以实现日志的指定输出
-    // 日志器基类，将来子类通过重写log_mode(const std::string &log_str)函数来实现不同的日志器类型
+    // 日志器基类，将来子类通过重写log_mode(const std::string &log_str, Level::value val, const std::vector<LogSink::ptr> &sinks, const LogCompletion::ptr &completion)函数来实现不同的日志器类型
     class Logger
     {
     public:
         using ptr = std::shared_ptr<Logger>;
         Logger(const std::string &logger_name, const std::vector<LogSink::ptr> &sinks,
                Level::value val = Level::value::DEBUG, const std::string &fmt_str = DEFAULT_FMT_STR)
-            : _logger_name(logger_name), _fmt_str(fmt_str),
-              _sinks(sinks.begin(), sinks.end()), _limit_out_level(val) {}
-        virtual ~Logger() {}
-        // 供用户调用以输出日志信息,成功输出返回0，未达到输出等级返回1，出错返回-1
-        int log(Level::value val, const std::string &filename, size_t line, const char *msg, ...)
+            : _logger_name(logger_name), _sinks(sinks.begin(), sinks.end()),
+              _limit_out_level(val), _fmt_str(fmt_str), _formatter(fmt_str),
+              _backtrace_size(0), _logger_id(next_logger_id()), _backtrace_slot(acquire_backtrace_slot())
+        {
+            for (int i = 0; i < Level::value::OFF; i++)
+            {
+                _sample_rates[i].store(1, std::memory_order_relaxed);
+                _sample_random[i].store(false, std::memory_order_relaxed);
+                _sample_counters[i].store(0, std::memory_order_relaxed);
+            }
+        }
+        virtual ~Logger() { release_backtrace_slot(_backtrace_slot); }
+        // 设置指定日志等级的采样率，rate为N表示该等级的日志每N条只输出1条，random为true时则改为以1/N的概率随机输出
+        // rate为0或1表示不进行采样(全部输出)，设置成功返回true，传入的日志等级不合法则返回false
+        bool set_sample_rate(Level::value val, size_t rate, bool random = false)
+        {
+            if (val < Level::value::DEBUG || val >= Level::value::OFF)
+                return false;
+            _sample_random[val].store(random, std::memory_order_relaxed);
+            _sample_rates[val].store(rate == 0 ? 1 : rate, std::memory_order_relaxed);
+            return true;
+        }
+        // 开启回溯功能：每个线程保留最近size条未达到输出等级的日志(不格式化)，当该线程输出ERROR及以上等级的日志时，
+        // 先将这些日志作为上下文格式化输出，再输出该条日志；size为0表示关闭回溯功能
+        void enable_backtrace(size_t size) { _backtrace_size.store(size, std::memory_order_relaxed); }
+        // 判断一条日志是否需要输出(包含等级过滤和采样决策)，由LOG系列宏在参数求值和格式化之前调用
+        // 开启回溯功能后，未达到输出等级的日志也需要交给log()记录到回溯环中
+        bool should_log(Level::value val)
         {
+            if (val < Level::value::DEBUG || val >= Level::value::OFF)
+                return false;
             if (val < _limit_out_level)
-                return 1;
+                return _backtrace_size.load(std::memory_order_relaxed) > 0;
+            if (!sinks_accept(val))
+                return false;
+            size_t rate = _sample_rates[val].load(std::memory_order_relaxed);
+            if (rate <= 1)
+                return true;
+            bool ret;
+            if (_sample_random[val].load(std::memory_order_relaxed))
+                ret = random_number() % rate == 0;
+            else
+                ret = _sample_counters[val].fetch_add(1, std::memory_order_relaxed) % rate == 0;
+            if (!ret)
+                _sampled_out.add();
+            return ret;
+        }
+        // 供用户调用以输出日志信息,成功输出返回0，未达到输出等级返回1，出错返回-1
+        // 直接调用log()只进行等级过滤，采样决策由should_log()完成
+        int log(Level::value val, std::string_view filename, size_t line, const char *msg, ...)
+        {
             va_list p;
             va_start(p, msg);
-            char msg_buffer[MAX_MSG] = {0};
-            if (vsnprintf(msg_buffer, MAX_MSG - 1, msg, p) < 0)
-                return -1;
+            int ret = vlog(val, filename, line, _sinks, nullptr, msg, p);
             va_end(p);
+            return ret;
+        }
+        // 输出一条需要确认落地的日志(如审计日志)，返回的完成通知在该日志被所有接收它的落地对象写入后完成，
+        // sync为true时还需将其同步到磁盘(异步日志器中由工作线程组提交)；不进行采样，未达到输出等级时返回已经完成的通知
+        // 出错时返回以失败完成的通知，因此返回值总是可以直接wait()或co_await
+        // 接收该日志的落地对象只在此处按等级筛选一次，之后只写入这些落地对象，保证需要等待的数量与实际写入的数量一致
+        LogCompletion::ptr log_durable(Level::value val, std::string_view filename, size_t line, bool sync, const char *msg, ...)
+        {
+            if (val < _limit_out_level || val >= Level::value::OFF)
+                return LogCompletion::ptr(new LogCompletion(0, sync));
+            std::vector<LogSink::ptr> sinks;
+            for (auto &sink : _sinks)
+            {
+                if (sink->should_log(val))
+                    sinks.push_back(sink);
+            }
+            LogCompletion::ptr completion(new LogCompletion(sinks.size(), sync));
+            if (sinks.empty())
+                return completion;
+            va_list p;
+            va_start(p, msg);
+            vlog(val, filename, line, sinks, completion, msg, p);
+            va_end(p);
+            return completion;
+        }
+        const std::string &name() const { return _logger_name; }
+        const std::vector<LogSink::ptr> &sinks() const { return _sinks; }
+        // 获取该日志器的统计数据快照
+        LoggerMetricsSnapshot metrics() const
+        {
+            LoggerMetricsSnapshot snap;
+            snap._name = _logger_name;
+            snap._records = _records.value();
+            snap._bytes = _bytes.value();
+            snap._errors = _errors.value();
+            snap._sampled_out = _sampled_out.value();
+            return snap;
+        }
+        // 获取该日志器使用的异步工作线程池，同步日志器返回nullptr
+        virtual AsynWorkerPool::ptr pool() const { return nullptr; }
+
+        // 将该日志器已经输出的日志全部落地并持久化，成功返回true
+        virtual bool flush()
+        {
+            bool ret = true;
+            for (auto &sink : _sinks)
+                ret &= sink->flush();
+            return ret;
+        }
+
+    protected:
+        // 将日志交给sinks中接收它的落地对象输出，completion为nullptr表示普通日志，需按should_log()筛选落地对象；
+        // 否则sinks是log_durable()已经筛选过的落地对象，全部写入，并在每个落地对象写入(和同步)后调用completion的finish()
+        virtual bool log_mode(const std::string &log_str, Level::value val, const std::vector<LogSink::ptr> &sinks, const LogCompletion::ptr &completion) = 0;
 
-            LogMsg log_msg(filename, line, time(nullptr), std::this_thread::get_id(), _logger_name, msg_buffer, val);
-            std::string log_str = LogFmt(_fmt_str, log_msg).get_result();
-            if (!log_mode(log_str))
+        // log()和log_durable()的实现，参数sinks和completion的含义同log_mode()
+        int vlog(Level::value val, std::string_view filename, size_t line, const std::vector<LogSink::ptr> &sinks, const LogCompletion::ptr &completion, const char *msg, va_list p)
+        {
+            char msg_buffer[MAX_MSG];
+            if (val < _limit_out_level)
+            {
+                size_t backtrace_size = _backtrace_size.load(std::memory_order_relaxed);
+                if (backtrace_size == 0)
+                    return 1;
+                int n = vsnprintf(msg_buffer, MAX_MSG - 1, msg, p);
+                if (n >= 0)
+                    record_backtrace(backtrace_size, val, filename, line, msg_view(msg_buffer, n));
+                return 1;
+            }
+            if (completion == nullptr && !sinks_accept(val))
+                return 1;
+            int n = vsnprintf(msg_buffer, MAX_MSG - 1, msg, p);
+            if (n < 0)
+            {
+                if (completion != nullptr)
+                    completion->abort();
                 return -1;
+            }
+            if (val >= Level::value::ERROR)
+            {
+                size_t backtrace_size = _backtrace_size.load(std::memory_order_relaxed);
+                if (backtrace_size > 0)
+                    emit_backtrace(backtrace_size);
+            }
 
-            return 0;
+            LogMsg log_msg(filename, line, time(nullptr), &Util::thread_info(), _logger_name, msg_view(msg_buffer, n), val,
+                           _sample_rates[val].load(std::memory_order_relaxed));
+            return output(log_msg, sinks, completion) ? 0 : -1;
+        }
+        // 将一条日志格式化到当前线程复用的字符串中再交给log_mode()输出，稳定运行时不会产生内存分配
+        // 按调用深度使用不同的字符串，保证落地对象在输出过程中再次调用日志器时不会覆盖正在输出的日志
+        bool output(const LogMsg &log_msg) { return output(log_msg, _sinks, nullptr); }
+        bool output(const LogMsg &log_msg, const std::vector<LogSink::ptr> &sinks, const LogCompletion::ptr &completion)
+        {
+            thread_local std::deque<std::string> buffers;
+            thread_local size_t depth = 0;
+            if (buffers.size() <= depth)
+                buffers.emplace_back();
+            std::string &log_str = buffers[depth];
+            log_str.clear();
+            depth++;
+            bool ret = _formatter.format(log_msg, log_str);
+            if (ret)
+                ret = log_mode(log_str, log_msg._level, sinks, completion);
+            else if (completion != nullptr)
+                completion->abort();
+            depth--;
+            if (!ret)
+            {
+                _errors.add();
+                return false;
+            }
+            _records.add();
+            _bytes.add(log_str.size());
+            return true;
+        }
+        // vsnprintf()返回的是完整输出所需的长度，日志主体消息被截断时以实际写入的长度为准
+        static std::string_view msg_view(const char *msg_buffer, int n)
+        {
+            return std::string_view(msg_buffer, n < MAX_MSG - 1 ? n : MAX_MSG - 2);
+        }
+        // 判断是否至少有一个落地对象接收val等级的日志，都不接收时就无需格式化该日志
+        bool sinks_accept(Level::value val)
+        {
+            for (auto &sink : _sinks)
+            {
+                if (sink->should_log(val))
+                    return true;
+            }
+            return false;
         }
 
-    protected:
-        virtual bool log_mode(const std::string &log_str) = 0;
+        // 回溯环中保存的一条未格式化的日志
+        struct BacktraceRecord
+        {
+            std::string _filename;
+            size_t _line;
+            time_t _time;
+            const Util::ThreadInfo *_thread;
+            std::string _main_message;
+            Level::value _level;
+        };
+        // 每个线程每个日志器各有一个回溯环，所有记录在创建时预先分配，之后循环复用
+        struct BacktraceRing
+        {
+            std::vector<BacktraceRecord> _records;
+            size_t _owner = SIZE_MAX; // 使用该回溯环的日志器的id
+            size_t _next = 0;         // 下一条记录要写入的位置
+            size_t _count = 0;        // 当前保存的记录条数
+        };
+        // 获取当前线程中该日志器的回溯环，回溯大小发生变化时重新分配
+        // 回溯环按日志器的槽位号存放，槽位号在日志器析构后会被新的日志器复用，因此每个线程的回溯环数量不超过同时存在的日志器数量；
+        // 槽位中还残留着已析构的日志器的记录时(_owner与当前日志器id不同)直接丢弃
+        BacktraceRing &local_backtrace(size_t size)
+        {
+            thread_local std::vector<BacktraceRing> rings;
+            if (rings.size() <= _backtrace_slot)
+                rings.resize(_backtrace_slot + 1);
+            BacktraceRing &ring = rings[_backtrace_slot];
+            if (ring._owner != _logger_id)
+            {
+                ring._owner = _logger_id;
+                ring._next = ring._count = 0;
+            }
+            if (ring._records.size() != size)
+            {
+                ring._records.assign(size, BacktraceRecord());
+                for (auto &record : ring._records)
+                    record._main_message.reserve(DEFAULT_BACKTRACE_MSG_RESERVE);
+                ring._next = ring._count = 0;
+            }
+            return ring;
+        }
+        // 将一条未达到输出等级的日志记录到当前线程的回溯环中，环满时覆盖最旧的记录
+        void record_backtrace(size_t size, Level::value val, std::string_view filename, size_t line, std::string_view message)
+        {
+            BacktraceRing &ring = local_backtrace(size);
+            BacktraceRecord &record = ring._records[ring._next];
+            record._filename.assign(filename);
+            record._line = line;
+            record._time = time(nullptr);
+            record._thread = &Util::thread_info();
+            record._main_message.assign(message);
+            record._level = val;
+            ring._next = (ring._next + 1) % size;
+            if (ring._count < size)
+                ring._count++;
+        }
+        // 按从旧到新的顺序格式化并输出当前线程回溯环中的所有记录，然后清空回溯环
+        // size为调用者已经读取的回溯大小，不再重新读取，避免其间被enable_backtrace(0)修改为0
+        void emit_backtrace(size_t size)
+        {
+            if (size == 0)
+                return;
+            BacktraceRing &ring = local_backtrace(size);
+            size_t idx = (ring._next + size - ring._count) % size;
+            for (size_t i = 0; i < ring._count; i++, idx = (idx + 1) % size)
+            {
+                BacktraceRecord &record = ring._records[idx];
+                LogMsg log_msg(record._filename, record._line, record._time, record._thread, _logger_name,
+                               record._main_message, record._level);
+                output(log_msg);
+            }
+            ring._count = 0;
+        }
+        static size_t next_logger_id()
+        {
+            static std::atomic<size_t> id(0);
+            return id.fetch_add(1, std::memory_order_relaxed);
+        }
+        // 回溯环槽位号的分配器，槽位号尽量取已释放的最小值，使线程局部的回溯环数组保持紧凑
+        // 故意不析构：进程退出时仍可能有日志器在其他静态对象析构时才被释放
+        struct BacktraceSlots
+        {
+            std::mutex _mutex;
+            std::vector<size_t> _free; // 已释放的槽位号
+            size_t _next = 0;          // 从未使用过的最小槽位号
+        };
+        static BacktraceSlots &backtrace_slots()
+        {
+            static BacktraceSlots *slots = new BacktraceSlots;
+            return *slots;
+        }
+        static size_t acquire_backtrace_slot()
+        {
+            BacktraceSlots &slots = backtrace_slots();
+            std::unique_lock<std::mutex> lock(slots._mutex);
+            if (slots._free.empty())
+                return slots._next++;
+            auto it = std::min_element(slots._free.begin(), slots._free.end());
+            size_t slot = *it;
+            *it = slots._free.back();
+            slots._free.pop_back();
+            return slot;
+        }
+        static void release_backtrace_slot(size_t slot)
+        {
+            BacktraceSlots &slots = backtrace_slots();
+            std::unique_lock<std::mutex> lock(slots._mutex);
+            slots._free.push_back(slot);
+        }
+        // 线程局部的xorshift伪随机数生成器，用于随机采样，避免多线程竞争同一个随机数引擎
+        static uint64_t random_number()
+        {
+            thread_local uint64_t state = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
 
     protected:
-        std::string _logger_name;         // 日志器名称
-        std::vector<LogSink::ptr> _sinks; // 日志落地对象数组（支持日志同时向多个落地方向输出）
-        Level::value _limit_out_level;    // 限制输出的日志等级
-        std::string _fmt_str;             // 日志输出格式字符串
+        std::string _logger_name;                                // 日志器名称
+        std::vector<LogSink::ptr> _sinks;                        // 日志落地对象数组（支持日志同时向多个落地方向输出）
+        Level::value _limit_out_level;                           // 限制输出的日志等级
+        std::string _fmt_str;                                    // 日志输出格式字符串
+        LogFmt _formatter;                                       // 由_fmt_str解析得到的格式化对象，只在构造时解析一次
+        std::atomic<size_t> _sample_rates[Level::value::OFF];    // 各日志等级的采样率，1表示不采样
+        std::atomic<bool> _sample_random[Level::value::OFF];     // 各日志等级是否采用随机采样
+        std::atomic<size_t> _sample_counters[Level::value::OFF]; // 各日志等级的计数器，用于1/N的固定间隔采样
+        std::atomic<size_t> _backtrace_size;                     // 每个线程回溯环的大小，为0表示未开启回溯功能
+        const size_t _logger_id;                                 // 日志器的唯一id，用于识别回溯环槽位中残留的已析构日志器的记录
+        const size_t _backtrace_slot;                            // 日志器的回溯环槽位号，用于索引线程局部的回溯环
+        ShardedCounter _records;                                 // 成功输出的日志条数
+        ShardedCounter _bytes;                                   // 格式化后输出的总字节数
+        ShardedCounter _errors;                                  // 输出失败的日志条数
+        ShardedCounter _sampled_out;                             // 因采样而被丢弃的日志条数
     };
 
     // 同步日志器
@@ -80,13 +377,28 @@ namespace log_system
             : Logger(logger_name, sinks, val, fmt_str) {}
 
     protected:
-        bool log_mode(const std::string &log_str) override
+        bool log_mode(const std::string &log_str, Level::value val, const std::vector<LogSink::ptr> &sinks, const LogCompletion::ptr &completion) override
         {
             if (log_str == "")
+            {
+                if (completion != nullptr)
+                    completion->abort();
                 return false;
+            }
             bool ret = true;
-            for (auto &sink : _sinks)
-                ret &= sink->log(log_str);
+            for (auto &sink : sinks)
+            {
+                if (completion == nullptr && !sink->should_log(val))
+                    continue;
+                bool ok = sink->write_record(log_str, val);
+                if (completion != nullptr)
+                {
+                    if (ok && completion->sync())
+                        ok = sink->flush();
+                    completion->finish(ok);
+                }
+                ret &= ok;
+            }
             return ret;
         }
     };
@@ -98,23 +410,43 @@ namespace log_system
         friend class LoggerManager;
         using ptr = std::shared_ptr<AsynLogger>;
         ~AsynLogger() {}
+        AsynWorkerPool::ptr pool() const override { return _pool; }
+        // 先等待异步工作线程池处理完已放入的日志，再将所有落地对象持久化
+        bool flush() override
+        {
+            _pool->flush();
+            return Logger::flush();
+        }
 
     protected:
         AsynLogger(const AsynLogger &tp) = delete;
         AsynLogger &operator=(const AsynLogger &tp) = delete;
+        // pool为该日志器使用的异步工作线程池，为nullptr时使用全局默认的单例线程池
         AsynLogger(const std::string &logger_name, const std::vector<LogSink::ptr> &sinks,
-                   Level::value val = Level::value::DEBUG, const std::string &fmt_str = DEFAULT_FMT_STR)
-            : Logger(logger_name, sinks, val, fmt_str) {}
+                   Level::value val = Level::value::DEBUG, const std::string &fmt_str = DEFAULT_FMT_STR,
+                   const AsynWorkerPool::ptr &pool = nullptr)
+            : Logger(logger_name, sinks, val, fmt_str),
+              _pool(pool != nullptr ? pool : AsynWorkerPool::get_instance(handle_buffer_data, thread_size)) {}
 
     protected:
-        bool log_mode(const std::string &log_str) override
+        bool log_mode(const std::string &log_str, Level::value val, const std::vector<LogSink::ptr> &sinks, const LogCompletion::ptr &completion) override
         {
             if (log_str == "")
+            {
+                if (completion != nullptr)
+                    completion->abort();
                 return false;
+            }
             bool ret = true;
-            for (auto &sink : _sinks)
-                ret &= AsynWorkerPool::get_instance(handle_buffer_data, thread_size)
-                           ->push(Buffer_data(sink, log_str));
+            for (auto &sink : sinks)
+            {
+                if (completion == nullptr && !sink->should_log(val))
+                    continue;
+                bool ok = _pool->push(sink, log_str, val, completion);
+                if (!ok && completion != nullptr) // 没有放入线程池的日志不会再被工作线程处理
+                    completion->finish(false);
+                ret &= ok;
+            }
             return ret;
         }
 
@@ -123,8 +455,11 @@ namespace log_system
         // 将来传入异步工作线程池的日志数据处理的回调函数
         static bool handle_buffer_data(const Buffer_data &data)
         {
-            return data._sink->log(data._log_str);
+            return data._sink->write_record(data._log_str, data._level);
         }
+
+    protected:
+        AsynWorkerPool::ptr _pool; // 该日志器使用的异步工作线程池
     };
     const size_t AsynLogger::thread_size = DEFAULT_ASYN_THREAD_SIZE;
 
@@ -134,27 +469,75 @@ namespace log_system
     {
     public:
         using ptr = std::shared_ptr<LoggerManager>;
-        ~LoggerManager() {}
-        // 根据传入的参数向LoggerManager添加新的logger，如果日志器已经存在或者logger_name为空或者发生其他错误则返回false，成功添加则返回true
+        ~LoggerManager() { stop_metrics_report(); }
+        // 根据传入的参数向LoggerManager添加新的logger，如果日志器已经存在或者logger_name为空或者fmt_str不合法或者发生其他错误则返回false，成功添加则返回true
+        // pool_name只对异步日志器有效，为空表示使用全局默认的异步工作线程池，否则使用add_pool()创建的同名线程池，该线程池不存在时返回false
         bool add_logger(const std::string &logger_name, LoggerType type = SYNC_LOGGER, const std::vector<LogSink::ptr> &sinks = {StdoutSink::get_sink()},
-                        Level::value val = Level::value::DEBUG, const std::string &fmt_str = DEFAULT_FMT_STR)
+                        Level::value val = Level::value::DEBUG, const std::string &fmt_str = DEFAULT_FMT_STR,
+                        const std::string &pool_name = "")
         {
-            if (logger_name == "")
+            Logger::ptr tmp = create_logger(logger_name, type, sinks, val, fmt_str, pool_name);
+            if (tmp == nullptr)
                 return false;
             std::unique_lock<std::mutex> loggers_lock(_loggers_mutex);
             if (_loggers_hash.find(logger_name) != _loggers_hash.end())
                 return false;
-            if (type == SYNC_LOGGER)
+            _loggers_hash[logger_name] = tmp;
+            return true;
+        }
+        // 根据传入的参数创建日志器但不添加到LoggerManager中，参数与add_logger()相同，失败返回nullptr
+        // 用于先构建好一组日志器，再通过replace_loggers()一次性替换
+        Logger::ptr create_logger(const std::string &logger_name, LoggerType type = SYNC_LOGGER, const std::vector<LogSink::ptr> &sinks = {StdoutSink::get_sink()},
+                                  Level::value val = Level::value::DEBUG, const std::string &fmt_str = DEFAULT_FMT_STR,
+                                  const std::string &pool_name = "")
+        {
+            if (logger_name == "" || !LogFmt(fmt_str).is_valid()) // 格式化字符串不合法时该日志器的每条日志都会输出失败，因此直接拒绝创建
+                return Logger::ptr(nullptr);
+            AsynWorkerPool::ptr pool;
+            if (type == ASYNC_LOGGER && pool_name != "")
             {
-                Logger::ptr tmp(new SynLogger(logger_name, sinks, val, fmt_str));
-                _loggers_hash[logger_name] = tmp;
+                pool = AsynWorkerPool::get_pool(pool_name);
+                if (pool == nullptr)
+                    return Logger::ptr(nullptr);
             }
+            if (type == SYNC_LOGGER)
+                return Logger::ptr(new SynLogger(logger_name, sinks, val, fmt_str));
             else if (type == ASYNC_LOGGER)
+                return Logger::ptr(new AsynLogger(logger_name, sinks, val, fmt_str, pool));
+            return Logger::ptr(nullptr);
+        }
+        // 在一次加锁中添加或替换一组日志器，并移除名称在removed中的日志器，之后调用get_logger()的线程要么获取到全部旧的日志器，要么获取到全部新的日志器
+        // 已经获取了旧日志器的调用者仍可继续使用旧日志器，直到其重新调用get_logger()
+        void replace_loggers(const std::vector<Logger::ptr> &loggers, const std::vector<std::string> &removed = {})
+        {
+            std::vector<Logger::ptr> old;
             {
-                Logger::ptr tmp(new AsynLogger(logger_name, sinks, val, fmt_str));
-                _loggers_hash[logger_name] = tmp;
+                std::unique_lock<std::mutex> loggers_lock(_loggers_mutex);
+                for (auto &name : removed)
+                {
+                    auto it = _loggers_hash.find(name);
+                    if (it == _loggers_hash.end())
+                        continue;
+                    old.push_back(it->second);
+                    _loggers_hash.erase(it);
+                }
+                for (auto &logger : loggers)
+                {
+                    if (logger == nullptr)
+                        continue;
+                    auto it = _loggers_hash.find(logger->name());
+                    if (it != _loggers_hash.end())
+                        old.push_back(it->second);
+                    _loggers_hash[logger->name()] = logger;
+                }
             }
-            return true;
+            for (auto &logger : old) // 将旧日志器已经放入线程池的日志落地后再释放
+                logger->flush();
+        }
+        // 根据配置创建名为pool_name的异步工作线程池，供之后添加的异步日志器指定使用，名称已存在或配置不合法时返回false
+        bool add_pool(const std::string &pool_name, const AsynPoolConfig &config)
+        {
+            return AsynWorkerPool::create_pool(pool_name, AsynLogger::handle_buffer_data, config);
         }
         // 根据logger_name获取已经存在的Logger,获取失败返回nullptr，成功则返回指向该Logger的智能指针
         Logger::ptr get_logger(const std::string &logger_name)
@@ -166,6 +549,100 @@ namespace log_system
                 return _loggers_hash[logger_name];
             return Logger::ptr(nullptr);
         }
+        // 获取所有日志器、它们使用的异步工作线程池以及落地对象(包括路由落地对象的子落地对象)的统计数据快照
+        MetricsSnapshot get_metrics()
+        {
+            std::vector<Logger::ptr> loggers;
+            {
+                std::unique_lock<std::mutex> loggers_lock(_loggers_mutex);
+                for (auto &it : _loggers_hash)
+                    loggers.push_back(it.second);
+            }
+            MetricsSnapshot snap;
+            std::vector<AsynWorkerPool *> pools;
+            std::vector<LogSink *> sinks;
+            std::vector<LogSink::ptr> pending;
+            for (auto &logger : loggers)
+            {
+                snap._loggers.push_back(logger->metrics());
+                AsynWorkerPool::ptr pool = logger->pool();
+                if (pool != nullptr && std::find(pools.begin(), pools.end(), pool.get()) == pools.end())
+                {
+                    pools.push_back(pool.get());
+                    snap._pools.push_back(pool->metrics());
+                }
+                pending.insert(pending.end(), logger->sinks().begin(), logger->sinks().end());
+            }
+            while (!pending.empty())
+            {
+                LogSink::ptr sink = pending.back();
+                pending.pop_back();
+                if (std::find(sinks.begin(), sinks.end(), sink.get()) != sinks.end())
+                    continue;
+                sinks.push_back(sink.get());
+                snap._sinks.push_back(sink->metrics());
+                LevelRouteSink *route = dynamic_cast<LevelRouteSink *>(sink.get());
+                if (route != nullptr)
+                {
+                    for (auto &r : route->routes())
+                        pending.push_back(r._sink);
+                }
+            }
+            return snap;
+        }
+        // 启动统计数据报告线程，每隔interval_ms毫秒获取一次统计数据快照
+        // path不为空时将快照追加写入该统计文件，否则以INFO等级通过名为logger_name的日志器输出，已经启动或参数不合法时返回false
+        bool start_metrics_report(size_t interval_ms, const std::string &path = "", const std::string &logger_name = "root")
+        {
+            if (interval_ms == 0)
+                return false;
+            FileSink::ptr file;
+            Logger::ptr logger;
+            if (path != "")
+            {
+                file = FileSink::get_sink(path);
+                if (file == nullptr)
+                    return false;
+            }
+            else
+            {
+                logger = get_logger(logger_name);
+                if (logger == nullptr)
+                    return false;
+            }
+            std::unique_lock<std::mutex> report_lock(_report_mutex);
+            if (_report_thread.joinable())
+                return false;
+            _report_stop = false;
+            _report_thread = std::thread([this, interval_ms, file, logger]()
+                                         {
+                std::unique_lock<std::mutex> lock(_report_mutex);
+                while (!_report_cond.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]()
+                                              { return _report_stop; }))
+                {
+                    lock.unlock();
+                    std::string report = get_metrics().to_string();
+                    if (file != nullptr)
+                        file->log("---------- " + std::to_string(time(nullptr)) + " ----------\n" + report);
+                    else
+                        logger->log(Level::value::INFO, __FILE__, __LINE__, "metrics:\n%s", report.c_str());
+                    lock.lock();
+                } });
+            return true;
+        }
+        // 停止统计数据报告线程
+        void stop_metrics_report()
+        {
+            std::thread thread;
+            {
+                std::unique_lock<std::mutex> report_lock(_report_mutex);
+                _report_stop = true;
+                thread.swap(_report_thread);
+            }
+            _report_cond.notify_all();
+            if (thread.joinable())
+                thread.join();
+        }
         // 用户通过get_instance()来获取唯一的单例对象使用
         static LoggerManager::ptr get_instance()
         {
@@ -181,6 +658,10 @@ namespace log_system
     private:
         std::unordered_map<std::string, Logger::ptr> _loggers_hash; // 管理全局范围内的Logger，以logger_name为唯一标识
         std::mutex _loggers_mutex;                                  // 互斥锁，保护对_loggers_hash操作的线程安全
+        std::thread _report_thread;                                 // 统计数据报告线程
+        bool _report_stop = false;                                  // 统计数据报告线程的停止标志，受_report_mutex保护
+        std::mutex _report_mutex;                                   // 互斥锁，保护统计数据报告线程的启动和停止
+        std::condition_variable _report_cond;                       // 条件变量，报告线程在两次报告之间在该条件变量下等待
     };
 }
 
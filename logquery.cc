@@ -0,0 +1,245 @@
+// 该文件是日志查询工具，读取文件落地和滚动文件落地输出的日志文件，按时间范围、日志等级和子串筛选日志
+// 日志文件旁存在稀疏索引(见LogIndex)时，先在索引上二分查找出可能包含目标日志的块，只扫描这些块以及尚未建立索引的文件末尾部分；
+// 没有索引时扫描整个文件。日志文件和索引文件都通过mmap()读取，子串匹配使用SIMD加速(见Simd::find())
+// 写入日志时使用的格式化字符串保存在索引中，没有索引时需通过--format指定(默认为DEFAULT_FMT_STR)，查询时据此将每行日志解析回时间和等级
+//
+// 用法: ./logquery [选项] 日志文件...
+//   --build                建立或增量更新日志文件的索引，不进行查询
+//   --block-size 65536     建立索引时的块大小(字节)
+//   --format     "[%L][%m]%n"  写入日志时使用的格式化字符串，建立索引或没有索引时使用，已有索引时以索引中保存的为准
+//   --from       "2024-1-1 8:0:0"  只输出该时间及之后的日志，也可以只写日期或直接写时间戳
+//   --to         "2024-1-1 9:0:0"  只输出该时间及之前的日志
+//   --level      WARN      只输出该等级及以上的日志
+//   --grep       timeout   只输出包含该子串的日志
+//   --count                只输出匹配的日志条数
+//   --stats                在标准错误中输出实际扫描的字节数
+// 指定了时间或等级条件时，无法按格式解析的行不会被输出
+
+#include "log.h"
+#include "log_index.hpp"
+#include "simd.hpp"
+
+// 查询条件
+struct Query
+{
+    int64_t _from = INT64_MIN;                 // 时间范围的起点
+    int64_t _to = INT64_MAX;                   // 时间范围的终点
+    int _min_level = log_system::Level::DEBUG; // 最低日志等级
+    bool _filter = false;                      // 是否指定了时间或等级条件
+    std::string _grep;                         // 要查找的子串，为空时不按子串筛选
+    bool _count = false;                       // 是否只输出匹配条数
+    size_t _matched = 0;                       // 匹配的日志条数
+    size_t _scanned = 0;                       // 扫描过的字节数
+};
+
+// 将"年-月-日 时:分:秒"、"年-月-日"或时间戳形式的字符串转化为时间戳，失败返回false
+static bool parse_time(const std::string &str, int64_t &out)
+{
+    struct tm t = {};
+    int n = sscanf(str.c_str(), "%d-%d-%d %d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec);
+    if (n == 1 && str.find('-') == std::string::npos)
+    {
+        out = strtoll(str.c_str(), nullptr, 10);
+        return true;
+    }
+    if (n != 3 && n != 6)
+        return false;
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    t.tm_isdst = -1;
+    out = mktime(&t);
+    return out != -1;
+}
+
+// 判断一行日志是否满足时间和等级条件
+static bool match_line(const log_system::LogFmt &fmt, const Query &query, std::string_view line)
+{
+    if (!query._filter)
+        return true;
+    log_system::LogFields fields;
+    if (!fmt.parse(line, fields))
+        return false;
+    if (fields._level != log_system::Level::OFF && fields._level < query._min_level)
+        return false;
+    if ((query._from != INT64_MIN || query._to != INT64_MAX) && (fields._timestamp == -1 || fields._timestamp < query._from || fields._timestamp > query._to))
+        return false;
+    return true;
+}
+
+static void output_line(Query &query, std::string_view line)
+{
+    query._matched++;
+    if (!query._count)
+        fwrite(line.data(), 1, line.size(), stdout);
+}
+
+// 扫描[begin, end)范围内的日志，该范围总是从行首开始
+// 指定了子串时先用SIMD在整个范围内查找子串，只有包含子串的行才会被解析，其余的数据不会逐行处理
+static void scan_range(const log_system::LogFmt &fmt, Query &query, const char *data, size_t begin, size_t end)
+{
+    query._scanned += end - begin;
+    size_t pos = begin;
+    while (pos < end)
+    {
+        size_t line_begin = pos;
+        if (!query._grep.empty())
+        {
+            size_t found = pos + log_system::Simd::find(data + pos, end - pos, query._grep.data(), query._grep.size());
+            if (found >= end)
+                return;
+            line_begin = found;
+            while (line_begin > pos && data[line_begin - 1] != '\n')
+                line_begin--;
+        }
+        const char *nl = (const char *)memchr(data + line_begin, '\n', end - line_begin);
+        size_t line_end = nl == nullptr ? end : nl - data + 1;
+        std::string_view line(data + line_begin, line_end - line_begin);
+        if (match_line(fmt, query, line))
+            output_line(query, line);
+        pos = line_end;
+    }
+}
+
+// 查询一个日志文件，成功返回true
+static bool query_file(const std::string &path, const std::string &fmt_str, Query &query)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        fprintf(stderr, "无法打开文件: %s\n", path.c_str());
+        return false;
+    }
+    struct stat att;
+    if (fstat(fd, &att) == -1)
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = att.st_size;
+    if (size == 0)
+    {
+        close(fd);
+        return true;
+    }
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    const char *data = (const char *)p;
+
+    log_system::LogIndex index;
+    size_t scanned_to = 0;
+    std::string used_fmt = fmt_str;
+    if (index.load(path) && index.indexed_size() <= size)
+    {
+        used_fmt = index.fmt();
+        log_system::LogFmt fmt(used_fmt);
+        uint32_t levels = 0;
+        if (query._filter)
+        {
+            for (int i = query._min_level; i < log_system::Level::OFF; i++)
+                levels |= 1u << i;
+        }
+        else
+            levels = ~0u;
+        for (size_t i : index.select(query._from, query._to, levels))
+            scan_range(fmt, query, data, index.entry(i)._offset, index.entry(i)._offset + index.entry(i)._length);
+        scanned_to = index.indexed_size();
+    }
+    log_system::LogFmt fmt(used_fmt);
+    if (!fmt.is_line_format())
+    {
+        fprintf(stderr, "格式化字符串不能按行解析: %s\n", used_fmt.c_str());
+        munmap(p, size);
+        return false;
+    }
+    // 索引之后新追加的部分逐行扫描
+    scan_range(fmt, query, data, scanned_to, size);
+    munmap(p, size);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    Query query;
+    std::vector<std::string> files;
+    std::string fmt_str = DEFAULT_FMT_STR;
+    size_t block_size = DEFAULT_INDEX_BLOCK_SIZE;
+    bool build = false, stats = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string opt = argv[i], val = i + 1 < argc ? argv[i + 1] : "";
+        if (opt == "--build")
+            build = true;
+        else if (opt == "--count")
+            query._count = true;
+        else if (opt == "--stats")
+            stats = true;
+        else if (opt.compare(0, 2, "--") != 0)
+            files.push_back(opt);
+        else
+        {
+            i++;
+            if (opt == "--block-size")
+                block_size = strtoul(val.c_str(), nullptr, 10);
+            else if (opt == "--format")
+                fmt_str = val;
+            else if (opt == "--grep")
+                query._grep = val;
+            else if (opt == "--from" || opt == "--to")
+            {
+                if (!parse_time(val, opt == "--from" ? query._from : query._to))
+                {
+                    fprintf(stderr, "时间不合法: %s\n", val.c_str());
+                    return 1;
+                }
+                query._filter = true;
+            }
+            else if (opt == "--level")
+            {
+                int level = log_system::Level::OFF;
+                for (int l = log_system::Level::DEBUG; l < log_system::Level::OFF; l++)
+                {
+                    if (val == log_system::Level::to_string((log_system::Level::value)l))
+                        level = l;
+                }
+                if (level == log_system::Level::OFF)
+                {
+                    fprintf(stderr, "日志等级不合法: %s\n", val.c_str());
+                    return 1;
+                }
+                query._min_level = level;
+                query._filter = true;
+            }
+            else
+            {
+                fprintf(stderr, "未知选项: %s\n", opt.c_str());
+                return 1;
+            }
+        }
+    }
+    if (files.empty())
+    {
+        fprintf(stderr, "用法: %s [--build] [--format 格式] [--from 时间] [--to 时间] [--level 等级] [--grep 子串] [--count] 日志文件...\n", argv[0]);
+        return 1;
+    }
+    int ret = 0;
+    for (auto &file : files)
+    {
+        if (build)
+        {
+            if (!log_system::LogIndex::build(file, fmt_str, block_size))
+            {
+                fprintf(stderr, "建立索引失败: %s\n", file.c_str());
+                ret = 1;
+            }
+        }
+        else if (!query_file(file, fmt_str, query))
+            ret = 1;
+    }
+    if (!build && query._count)
+        printf("%zu\n", query._matched);
+    if (!build && stats)
+        fprintf(stderr, "匹配%zu条，扫描%zu字节\n", query._matched, query._scanned);
+    return ret;
+}
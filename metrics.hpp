@@ -0,0 +1,185 @@
+#ifndef LOG_SYSTEM_METRICS_HPP
+#define LOG_SYSTEM_METRICS_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <stdint.h>
+
+namespace log_system
+{
+#define METRICS_SHARDS 16          // 分片计数器的分片数量，不同线程尽量落在不同的分片上，避免争用同一缓存行
+#define HISTOGRAM_BUCKETS 40       // 直方图的桶数量，第i个桶统计[2^(i-1), 2^i)纳秒内的样本
+#define METRICS_CACHE_LINE_SIZE 64 // 缓存行大小，每个分片独占一个缓存行
+
+    // 统计模块，为日志器、异步工作线程池和日志落地对象提供低开销的计数器和直方图
+    namespace Metrics
+    {
+        // 获取当前线程使用的分片下标，每个线程第一次调用时分配，之后保持不变
+        inline size_t shard_index()
+        {
+            static std::atomic<size_t> next(0);
+            thread_local size_t idx = next.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARDS;
+            return idx;
+        }
+        // 计算ns落在直方图的第几个桶中
+        inline size_t bucket_index(uint64_t ns)
+        {
+            size_t idx = 0;
+            while (ns > 0 && idx < HISTOGRAM_BUCKETS - 1)
+                ns >>= 1, idx++;
+            return idx;
+        }
+    }
+
+    // 分片计数器，每个线程只修改自己分片上的原子变量，读取时再将所有分片求和
+    class ShardedCounter
+    {
+    public:
+        void add(uint64_t n = 1) { _shards[Metrics::shard_index()]._value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const
+        {
+            uint64_t sum = 0;
+            for (auto &shard : _shards)
+                sum += shard._value.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+    private:
+        struct alignas(METRICS_CACHE_LINE_SIZE) Shard
+        {
+            std::atomic<uint64_t> _value{0};
+        };
+        Shard _shards[METRICS_SHARDS];
+    };
+
+    // 直方图的快照，记录样本数量、总和、最大值和各个桶的样本数
+    struct HistogramSnapshot
+    {
+        uint64_t _count = 0;
+        uint64_t _sum = 0;
+        uint64_t _max = 0;
+        std::vector<uint64_t> _buckets;
+        // 估算分位数(p取值0~1)，返回对应桶的上界，没有样本时返回0
+        uint64_t percentile(double p) const
+        {
+            if (_count == 0)
+                return 0;
+            uint64_t target = (uint64_t)(p * _count);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < _buckets.size(); i++)
+            {
+                seen += _buckets[i];
+                if (seen > target)
+                    return i == 0 ? 0 : (i + 1 < _buckets.size() ? (1ull << i) - 1 : _max);
+            }
+            return _max;
+        }
+        uint64_t mean() const { return _count == 0 ? 0 : _sum / _count; }
+    };
+
+    // 以2的幂为桶边界的分片直方图，用于统计耗时(纳秒)
+    class Histogram
+    {
+    public:
+        void record(uint64_t ns)
+        {
+            Shard &shard = _shards[Metrics::shard_index()];
+            shard._buckets[Metrics::bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+            shard._sum.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t max = shard._max.load(std::memory_order_relaxed);
+            while (ns > max && !shard._max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+                ;
+        }
+        HistogramSnapshot snapshot() const
+        {
+            HistogramSnapshot snap;
+            snap._buckets.assign(HISTOGRAM_BUCKETS, 0);
+            for (auto &shard : _shards)
+            {
+                for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+                {
+                    uint64_t n = shard._buckets[i].load(std::memory_order_relaxed);
+                    snap._buckets[i] += n;
+                    snap._count += n;
+                }
+                snap._sum += shard._sum.load(std::memory_order_relaxed);
+                uint64_t max = shard._max.load(std::memory_order_relaxed);
+                snap._max = max > snap._max ? max : snap._max;
+            }
+            return snap;
+        }
+
+    private:
+        struct alignas(METRICS_CACHE_LINE_SIZE) Shard
+        {
+            std::atomic<uint64_t> _buckets[HISTOGRAM_BUCKETS] = {};
+            std::atomic<uint64_t> _sum{0};
+            std::atomic<uint64_t> _max{0};
+        };
+        Shard _shards[METRICS_SHARDS];
+    };
+
+    // 日志器的统计数据快照
+    struct LoggerMetricsSnapshot
+    {
+        std::string _name;
+        uint64_t _records = 0;     // 成功输出的日志条数
+        uint64_t _bytes = 0;       // 格式化后输出的总字节数
+        uint64_t _errors = 0;      // 输出失败的日志条数
+        uint64_t _sampled_out = 0; // 因采样而被丢弃的日志条数
+    };
+    // 异步工作线程池的统计数据快照
+    struct PoolMetricsSnapshot
+    {
+        std::string _name;
+        size_t _queue_depth = 0;       // 已放入但尚未处理完毕的日志数据条数
+        uint64_t _pushed = 0;          // 放入线程池的日志数据总条数
+        uint64_t _processed = 0;       // 已被工作线程处理完毕的日志数据总条数
+        uint64_t _swaps = 0;           // 双缓冲区的交换次数
+        uint64_t _push_blocks = 0;     // 生产者因缓冲区已满而阻塞的次数
+        uint64_t _notifies = 0;        // 生产者唤醒挂起的工作线程的次数
+        uint64_t _parks = 0;           // 工作线程因没有数据而挂起的次数
+        uint64_t _group_commits = 0;   // 工作线程为要求同步的日志进行组提交的次数
+        uint64_t _committed = 0;       // 通过组提交完成的日志条数，与_group_commits之比即平均每次fsync()合并的日志条数
+        HistogramSnapshot _push_block; // 生产者每次阻塞等待的耗时(纳秒)
+    };
+    // 日志落地对象的统计数据快照
+    struct SinkMetricsSnapshot
+    {
+        std::string _name;
+        uint64_t _records = 0;    // 落地的日志条数
+        uint64_t _bytes = 0;      // 落地的总字节数
+        uint64_t _errors = 0;     // 落地失败的次数
+        HistogramSnapshot _write; // 每次落地的耗时(纳秒)
+    };
+    // LoggerManager提供的全局统计数据快照
+    struct MetricsSnapshot
+    {
+        std::vector<LoggerMetricsSnapshot> _loggers;
+        std::vector<PoolMetricsSnapshot> _pools;
+        std::vector<SinkMetricsSnapshot> _sinks;
+        // 将快照转化为便于阅读的多行文本
+        std::string to_string() const
+        {
+            std::stringstream sstr;
+            for (auto &l : _loggers)
+                sstr << "logger " << l._name << " records=" << l._records << " bytes=" << l._bytes
+                     << " errors=" << l._errors << " sampled_out=" << l._sampled_out << "\n";
+            for (auto &p : _pools)
+                sstr << "pool " << p._name << " queue_depth=" << p._queue_depth << " pushed=" << p._pushed
+                     << " processed=" << p._processed << " swaps=" << p._swaps << " push_blocks=" << p._push_blocks
+                     << " notifies=" << p._notifies << " parks=" << p._parks
+                     << " group_commits=" << p._group_commits << " committed=" << p._committed
+                     << " push_block_p99_ns=" << p._push_block.percentile(0.99) << " push_block_max_ns=" << p._push_block._max << "\n";
+            for (auto &s : _sinks)
+                sstr << "sink " << s._name << " records=" << s._records << " bytes=" << s._bytes << " errors=" << s._errors
+                     << " write_p50_ns=" << s._write.percentile(0.5) << " write_p99_ns=" << s._write.percentile(0.99)
+                     << " write_max_ns=" << s._write._max << "\n";
+            return sstr.str();
+        }
+    };
+}
+
+#endif
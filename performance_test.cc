@@ -1,75 +1,353 @@
-// 该文件主要是进行当前环境下的同步/异步日志器向指定文件输出时的极限性能测试
+// 该文件是日志系统的性能测试套件，覆盖同步/异步日志器、不同线程数、不同日志大小、完整/最简输出格式以及各种落地方向
+// 每个测试场景都会输出吞吐量、单次调用延迟的分位数(p50/p99/p99.9/max)以及日志持久化落地的端到端耗时
+// 支持以表格、CSV或JSON Lines格式输出结果，便于在不同版本之间对比性能变化
+//
+// 用法: ./performance_test [选项]
+//   --mode      sync,async          测试的日志器类型，可选sync/async/async-numa(使用按NUMA节点划分队列的线程池)
+//   --threads   1,2,4               日志输出线程数
+//   --sizes     32,256,1024         每条日志的大小(字节)
+//   --patterns  minimal,full        输出格式，minimal为"%m%n"，full为默认格式DEFAULT_FMT_STR
+//   --sinks     file,roll,ring,null 落地方向，可选file/roll/ring/null/stdout
+//   --count     100000              每个场景输出的日志总条数
+//   --format    table               结果输出格式，可选table/csv/json
+//   --wake      balanced            异步线程池工作线程的唤醒模式，可选balanced/latency/cpu，不指定时使用默认线程池
+//   --escape-bench                  不运行性能测试，而是比较%M/%J转义日志消息时标量实现与SSE2/AVX2实现在不同消息大小下的吞吐量
 
 #include "log.h"
 #include <chrono>
+#include <algorithm>
+#include <dirent.h>
 #include <stdlib.h>
 
-// 构造log_len长度的日志，将log_size条日志平均分发给thread_size个线程通过logger_name日志器输出，并计算耗时
-void test(const std::string &logger_name, size_t thread_size, size_t log_size, size_t log_len)
+#define BENCH_DIR "./data/bench/" // 测试过程中产生的日志文件所在目录
+
+// 测试套件专用的空落地类，丢弃所有日志，用于测量日志器本身(格式化、排队)的开销
+class NullSink : public log_system::LogSink
 {
-    // 对传入参数进行条件判断
-    if (thread_size <= 0 || log_size <= 0 || log_len <= 0)
+public:
+    bool log(const std::string &) override { return true; }
+    static log_system::LogSink::ptr get_sink()
+    {
+        static log_system::LogSink::ptr sink(new NullSink());
+        return sink;
+    }
+
+private:
+    NullSink() {}
+};
+
+// 一个测试场景的参数
+struct Scenario
+{
+    std::string _mode;
+    size_t _threads;
+    size_t _size;
+    std::string _pattern;
+    std::string _sink;
+};
+
+// 一个测试场景的结果，时间单位：延迟为纳秒，耗时为秒
+struct Result
+{
+    double _call_seconds; // 所有线程完成日志调用的耗时(取最慢的线程)
+    double _e2e_seconds;  // 从开始输出到所有日志都持久化落地的耗时
+    uint64_t _p50, _p99, _p999, _max;
+    size_t _errors;
+};
+
+// 将以','分隔的字符串拆分成数组
+static std::vector<std::string> split(const std::string &str)
+{
+    std::vector<std::string> ret;
+    size_t lpos = 0;
+    while (lpos <= str.size())
+    {
+        size_t rpos = str.find(',', lpos);
+        if (rpos == std::string::npos)
+            rpos = str.size();
+        if (rpos > lpos)
+            ret.push_back(str.substr(lpos, rpos - lpos));
+        lpos = rpos + 1;
+    }
+    return ret;
+}
+
+static std::vector<size_t> split_num(const std::string &str)
+{
+    std::vector<size_t> ret;
+    for (auto &item : split(str))
+        ret.push_back(strtoul(item.c_str(), nullptr, 10));
+    return ret;
+}
+
+// 将测试目录下的所有文件清空，避免测试文件占用过多的磁盘空间(文件仍被落地对象打开，所以不能直接删除)
+static void truncate_bench_files()
+{
+    DIR *dir = opendir(BENCH_DIR);
+    if (dir == nullptr)
         return;
-    // 根据名称获取日志器
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::string path = std::string(BENCH_DIR) + entry->d_name;
+        if (truncate(path.c_str(), 0) == -1)
+            continue;
+    }
+    closedir(dir);
+}
+
+static log_system::LogSink::ptr make_sink(const std::string &name)
+{
+    if (name == "file")
+        return log_system::get_sink<log_system::FileSink>(BENCH_DIR "file.log");
+    else if (name == "roll")
+        return log_system::get_sink<log_system::RollFileSinkBySize>(BENCH_DIR "roll.log", 64 * 1024 * 1024);
+    else if (name == "ring")
+        return log_system::get_sink<log_system::RingBufferSink>(BENCH_DIR "ring.dump");
+    else if (name == "stdout")
+        return log_system::get_sink<log_system::StdoutSink>();
+    else if (name == "null")
+        return NullSink::get_sink();
+    return nullptr;
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t idx = (size_t)(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+static std::string g_wake = ""; // --wake选项指定的唤醒模式，为空时异步模式使用默认线程池
+
+// 获取测试模式对应的线程池名称，第一次调用时创建对应的线程池
+// async-numa模式使用按NUMA节点划分队列的线程池，没有NUMA信息或只有一个节点时退化为单个队列，结果与async模式可直接对比
+// 指定了--wake时async模式使用按该唤醒模式配置的线程池，否则使用默认线程池
+static std::string bench_pool(const std::string &mode)
+{
+    if (mode == "sync" || (mode == "async" && g_wake.empty()))
+        return "";
+    std::string name = "bench_" + mode;
+    static std::unordered_map<std::string, bool> created;
+    if (created.find(name) == created.end())
+    {
+        log_system::AsynPoolConfig config;
+        config._numa = mode == "async-numa";
+        config.set_wake_mode(g_wake == "latency" ? log_system::WAKE_LATENCY : (g_wake == "cpu" ? log_system::WAKE_CPU : log_system::WAKE_BALANCED));
+        created[name] = log_system::add_pool(name, config);
+    }
+    return created[name] ? name : "";
+}
+
+// 运行一个测试场景，将count条日志平均分发给各个线程输出，失败返回false
+static bool run(const Scenario &sc, size_t count, size_t id, Result &result)
+{
+    log_system::LogSink::ptr sink = make_sink(sc._sink);
+    if (sink == nullptr)
+        return false;
+    std::string logger_name = "bench_" + std::to_string(id);
+    std::string pattern = sc._pattern == "full" ? DEFAULT_FMT_STR : "%m%n";
+    log_system::LoggerType type = sc._mode == "sync" ? log_system::SYNC_LOGGER : log_system::ASYNC_LOGGER;
+    std::string pool_name = bench_pool(sc._mode);
+    if (!log_system::add_logger(logger_name, type, {sink}, log_system::Level::DEBUG, pattern, pool_name))
+        return false;
     log_system::Logger::ptr logger = log_system::get_logger(logger_name);
-    if (logger == nullptr)
-        return;
-    // 构建指定长度的日志字符串，且最后一个字符为'\n'
-    std::string str(log_len - 1, 'L');
-    str.push_back('\n');
-    // 计算每个线程要输出日志的数量并保存
-    std::vector<size_t> thread_log_size;
-    for (size_t i = 0; i < thread_size; i++)
-        thread_log_size.emplace_back(log_size / thread_size);
-    thread_log_size[0] += log_size % thread_size;
-    // 用于保存将来的总耗时
-    double all_cost = 0;
-    // 创建指定数量的线程
+
+    std::string str(sc._size > 1 ? sc._size - 1 : 1, 'L'); // 加上格式中的换行后，minimal格式下每条日志恰好为size字节
+    std::vector<size_t> thread_count(sc._threads, count / sc._threads);
+    thread_count[0] += count % sc._threads;
+    std::vector<std::vector<uint64_t>> latencies(sc._threads);
+    std::vector<double> cost(sc._threads, 0);
+    std::vector<size_t> errors(sc._threads, 0);
+    for (size_t i = 0; i < sc._threads; i++)
+        latencies[i].resize(thread_count[i]);
+
     std::vector<std::thread> threads;
-    auto all_start = std::chrono::high_resolution_clock::now(); // 总计时开始
-    for (size_t i = 0; i < thread_size; i++)
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sc._threads; i++)
     {
         threads.emplace_back([&, i]()
                              {
-            auto start = std::chrono::high_resolution_clock::now(); // 单线程计时开始
-            // 让线程输出指定条数的日志
-            for (size_t j = 0; j < thread_log_size[i]; j++)
-                LOG_DEBUG(logger, str.c_str());
-            auto end = std::chrono::high_resolution_clock::now(); // 单线程计时结束
-            std::chrono::duration<double> time = end - start;     // 计算单线程耗时
-            std::chrono::duration<double> all_time = end-all_start;
-            all_cost = (all_cost > all_time.count()? all_cost:all_time.count()); // 计算总耗时
-            std::cout << "线程" << i+1 << "输出：" << thread_log_size[i] << "条日志\t耗时: " << time.count() << "s\n"; });
+            for (size_t j = 0; j < thread_count[i]; j++)
+            {
+                auto begin = std::chrono::steady_clock::now();
+                if (LOG_DEBUG(logger, "%s", str.c_str()) != 0)
+                    errors[i]++;
+                auto end = std::chrono::steady_clock::now();
+                latencies[i][j] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+            }
+            // 每个线程只写自己的槽位，汇总在所有线程结束后进行，避免多线程同时修改同一个变量
+            cost[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); });
     }
-    // 回收线程
     for (auto &thread : threads)
         thread.join();
+    if (!logger->flush())
+        errors[0]++;
+    auto durable = std::chrono::steady_clock::now();
+
+    std::vector<uint64_t> all;
+    all.reserve(count);
+    for (auto &lat : latencies)
+        all.insert(all.end(), lat.begin(), lat.end());
+    std::sort(all.begin(), all.end());
+    result._call_seconds = *std::max_element(cost.begin(), cost.end());
+    result._e2e_seconds = std::chrono::duration<double>(durable - start).count();
+    result._p50 = percentile(all, 0.5);
+    result._p99 = percentile(all, 0.99);
+    result._p999 = percentile(all, 0.999);
+    result._max = all.empty() ? 0 : all.back();
+    result._errors = 0;
+    for (auto e : errors)
+        result._errors += e;
+    truncate_bench_files();
+    return true;
+}
 
-    std::cout << "总输出日志条数: " << (size_t)log_size << "条" << std::endl;
-    std::cout << "总输出日志大小: " << (size_t)(log_size * log_len / 1024 / 1024) << "MB" << std::endl;
-    std::cout << "总消耗时间: " << all_cost << "s\n";
-    std::cout << "平均每秒输出日志条数: " << (size_t)(log_size / all_cost) << "条" << std::endl;
-    std::cout << "平均每秒输出日志大小: " << (size_t)(log_size * log_len / all_cost / 1024 / 1024) << "MB" << std::endl;
+// 比较转义扫描的各个实现，每种消息大小分别测试不含需转义字符(clean)和每64字节含一个需转义字符(dirty)两种内容
+static void escape_bench()
+{
+    struct Impl
+    {
+        const char *_name;
+        log_system::Simd::FindEscapeFunc _func;
+    };
+    std::vector<Impl> impls = {{"scalar", log_system::Simd::find_escape_scalar}};
+#if defined(__SSE2__)
+    impls.push_back({"sse2", log_system::Simd::find_escape_sse2});
+#endif
+#if defined(LOG_SYSTEM_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        impls.push_back({"avx2", log_system::Simd::find_escape_avx2});
+#endif
+    printf("%-4s %-7s %6s %-7s %10s\n", "item", "content", "size", "impl", "MB/s");
+    std::string out;
+    for (bool json : {false, true})
+        for (bool dirty : {false, true})
+            for (size_t size : {64, 256, 1024, 4096, 16384})
+            {
+                std::string msg(size, 'a');
+                for (size_t i = 0; i < size; i++)
+                    msg[i] = dirty && i % 64 == 63 ? (json ? '"' : '\n') : (char)('a' + i % 26);
+                size_t iters = (size_t)64 * 1024 * 1024 / size;
+                for (auto &impl : impls)
+                {
+                    volatile size_t total = 0; // 使用转义结果，避免循环被编译器优化掉
+                    auto start = std::chrono::steady_clock::now();
+                    for (size_t i = 0; i < iters; i++)
+                    {
+                        out.clear();
+                        log_system::LogFmt::append_escaped(out, msg, json, impl._func);
+                        total += out.size();
+                    }
+                    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    printf("%-4s %-7s %6zu %-7s %10.0f\n", json ? "%J" : "%M", dirty ? "dirty" : "clean", size, impl._name,
+                           (double)size * iters / sec / 1024 / 1024);
+                }
+            }
 }
-// 同步日志器性能测试
-void syn_test()
+
+static void print_header(const std::string &format)
 {
-    log_system::add_logger("SynLogger", log_system::SYNC_LOGGER, {log_system::get_sink<log_system::FileSink>("./data/file.log")}, log_system::Level::DEBUG, "%m");
-    // test("SynLogger", 1, 1000000, 100); // 单线程输出
-    test("SynLogger", 3, 1000000, 100); // 多线程输出
+    if (format == "csv")
+        printf("mode,threads,size,pattern,sink,count,calls_per_sec,durable_per_sec,mb_per_sec,p50_ns,p99_ns,p999_ns,max_ns,e2e_s,errors\n");
+    else if (format == "table")
+        printf("%-10s %3s %6s %-8s %-6s %12s %12s %9s %8s %8s %9s %10s %8s\n", "mode", "thr", "size", "pattern", "sink",
+               "calls/s", "durable/s", "MB/s", "p50ns", "p99ns", "p99.9ns", "max_ns", "e2e_s");
 }
-// 异步日志器性能测试
-// （对于异步日志器只计算日志输出到异步线程池所提供的缓冲区中的时间，并不计算实际落入外设中的时间）
-void asyn_test()
+
+static void print_result(const std::string &format, const Scenario &sc, size_t count, const Result &r)
 {
-    log_system::add_logger("AsynLogger", log_system::ASYNC_LOGGER, {log_system::get_sink<log_system::FileSink>("./data/file.log")}, log_system::Level::DEBUG, "%m");
-    // test("AsynLogger", 1, 1000000, 100); // 单线程输出
-    test("AsynLogger", 3, 1000000, 100); // 多线程输出
+    double calls = count / r._call_seconds;
+    double durable = count / r._e2e_seconds;
+    double mb = (double)count * sc._size / r._e2e_seconds / 1024 / 1024;
+    if (format == "csv")
+        printf("%s,%zu,%zu,%s,%s,%zu,%.0f,%.0f,%.2f,%llu,%llu,%llu,%llu,%.6f,%zu\n", sc._mode.c_str(), sc._threads, sc._size,
+               sc._pattern.c_str(), sc._sink.c_str(), count, calls, durable, mb, (unsigned long long)r._p50,
+               (unsigned long long)r._p99, (unsigned long long)r._p999, (unsigned long long)r._max, r._e2e_seconds, r._errors);
+    else if (format == "json")
+        printf("{\"mode\":\"%s\",\"threads\":%zu,\"size\":%zu,\"pattern\":\"%s\",\"sink\":\"%s\",\"count\":%zu,"
+               "\"calls_per_sec\":%.0f,\"durable_per_sec\":%.0f,\"mb_per_sec\":%.2f,\"p50_ns\":%llu,\"p99_ns\":%llu,"
+               "\"p999_ns\":%llu,\"max_ns\":%llu,\"e2e_s\":%.6f,\"errors\":%zu}\n",
+               sc._mode.c_str(), sc._threads, sc._size, sc._pattern.c_str(), sc._sink.c_str(), count, calls, durable, mb,
+               (unsigned long long)r._p50, (unsigned long long)r._p99, (unsigned long long)r._p999,
+               (unsigned long long)r._max, r._e2e_seconds, r._errors);
+    else
+        printf("%-10s %3zu %6zu %-8s %-6s %12.0f %12.0f %9.2f %8llu %8llu %9llu %10llu %8.3f%s\n", sc._mode.c_str(), sc._threads,
+               sc._size, sc._pattern.c_str(), sc._sink.c_str(), calls, durable, mb, (unsigned long long)r._p50,
+               (unsigned long long)r._p99, (unsigned long long)r._p999, (unsigned long long)r._max, r._e2e_seconds,
+               r._errors ? " (errors)" : "");
+    fflush(stdout);
 }
 
-int main()
+int main(int argc, char *argv[])
 {
-    // syn_test();
-    asyn_test();
+    std::vector<std::string> modes = {"sync", "async"};
+    std::vector<size_t> thread_sizes = {1, 2, 4};
+    std::vector<size_t> sizes = {32, 256, 1024};
+    std::vector<std::string> patterns = {"minimal", "full"};
+    std::vector<std::string> sinks = {"file", "roll", "ring", "null"};
+    size_t count = 100000;
+    std::string format = "table";
+    bool escape = false;
+    for (int i = 1; i < argc; i += 2)
+    {
+        std::string opt = argv[i], val = i + 1 < argc ? argv[i + 1] : "";
+        if (opt == "--escape-bench")
+        {
+            escape = true;
+            i--;
+        }
+        else if (opt == "--mode")
+            modes = split(val);
+        else if (opt == "--threads")
+            thread_sizes = split_num(val);
+        else if (opt == "--sizes")
+            sizes = split_num(val);
+        else if (opt == "--patterns")
+            patterns = split(val);
+        else if (opt == "--sinks")
+            sinks = split(val);
+        else if (opt == "--count")
+            count = strtoul(val.c_str(), nullptr, 10);
+        else if (opt == "--format")
+            format = val;
+        else if (opt == "--wake")
+            g_wake = val;
+        else
+        {
+            fprintf(stderr, "未知选项: %s\n", opt.c_str());
+            return 1;
+        }
+    }
+    if (count == 0)
+        return 1;
+    if (escape)
+    {
+        escape_bench();
+        return 0;
+    }
+
+    print_header(format);
+    size_t id = 0;
+    for (auto &mode : modes)
+        for (auto threads : thread_sizes)
+            for (auto size : sizes)
+                for (auto &pattern : patterns)
+                    for (auto &sink : sinks)
+                    {
+                        if (threads == 0 || size == 0)
+                            continue;
+                        Scenario sc{mode, threads, size, pattern, sink};
+                        Result result;
+                        if (!run(sc, count, id++, result))
+                        {
+                            fprintf(stderr, "场景运行失败: %s %zu %zu %s %s\n", mode.c_str(), threads, size, pattern.c_str(), sink.c_str());
+                            continue;
+                        }
+                        print_result(format, sc, count, result);
+                    }
     return 0;
 }
@@ -0,0 +1,407 @@
+#ifndef LOG_SYSTEM_SHM_CHANNEL_HPP
+#define LOG_SYSTEM_SHM_CHANNEL_HPP
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "level.hpp"
+#include "sink.hpp"
+
+namespace log_system
+{
+#define SHM_CHANNEL_MAGIC 0x4c4f4753484d3032ull // 共享内存通道的魔数，用于判断共享内存是否已初始化完毕(布局变化时递增)
+#define DEFAULT_SHM_SLOT_COUNT 4096            // 共享内存环默认的槽位数量
+#define DEFAULT_SHM_SLOT_SIZE 1024             // 共享内存环中每个槽位默认能存放的日志字节数
+#define SHM_STALL_TIMEOUT_MS 5000              // 写入进程仍存活时，槽位被占用多久仍未发布才视为写入进程已卡死
+#define SHM_CONSUMER_IDLE_MS 100               // 消费线程没有日志可处理时在futex上等待的最长时间，超时后重新检查卡住的槽位
+#define SHM_ATTACH_TIMEOUT_MS 1000             // 等待其他进程初始化共享内存的最长时间
+
+    // 多进程共享内存日志通道，用于多个进程(如预先fork的工作进程)共同输出同一个文件的场景
+    // 各进程通过get_sink()获取同名的ShmChannelSink，日志被写入/dev/shm中的同一个共享内存环，
+    // 由唯一的消费者(任一进程中调用start_consumer()启动的线程)按序取出后交给目标落地对象，输出不会交错，也只有一个进程写文件
+    // 共享内存环为槽位带序号的有界队列(Vyukov MPMC队列)：生产者先通过CAS推进全局写位置来占有槽位，写完后再通过CAS发布该槽位
+    // 崩溃恢复：生产者占有槽位后会记录自己的进程ID和占有时间，消费者发现槽位被占有但迟迟未发布时，
+    // 若占有者进程已不存在，或槽位被占有超过SHM_STALL_TIMEOUT_MS，就通过CAS将该槽位标记为已消费并跳过，计入recovered()；
+    // 之后占有者若恢复执行，其发布操作的CAS会失败，该条日志被丢弃而不会覆盖已回收的槽位的状态；
+    // 但卡死的占有者若在槽位被回收并再次被占有后才继续复制日志内容，可能改写新日志的内容，因此超时时间应远大于正常的写入耗时
+    // 进程ID会被复用，因此判断进程是否存在时还要比较其启动时间(/proc/<pid>/stat的第22项)，防止把复用了该ID的新进程误认为原进程
+    // 消费线程没有日志可处理时在共享内存头部的futex上等待，生产者只在消费者处于等待状态时才唤醒它，繁忙时不产生额外的系统调用
+    // 环满时新日志直接丢弃并计入dropped()，不会阻塞生产者；超过槽位大小的日志会被截断
+    class ShmChannelSink : public LogSink
+    {
+    public:
+        using ptr = std::shared_ptr<ShmChannelSink>;
+        ~ShmChannelSink()
+        {
+            stop_consumer();
+            if (_header != nullptr)
+                munmap(_header, _map_size);
+        }
+        bool log(const std::string &msg) override { return log(msg, Level::value::OFF); }
+        bool log(const std::string &msg, Level::value val) override
+        {
+            uint64_t pos = _header->_enqueue_pos.load(std::memory_order_relaxed);
+            Slot *slot;
+            while (true)
+            {
+                slot = slot_at(pos);
+                uint64_t seq = slot->_seq.load(std::memory_order_acquire);
+                int64_t diff = (int64_t)seq - (int64_t)pos;
+                if (diff == 0)
+                {
+                    if (_header->_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    _header->_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                else
+                    pos = _header->_enqueue_pos.load(std::memory_order_relaxed);
+            }
+            // 推进写位置后槽位已归当前生产者独占，先记录占有者和占有时间，再以release语义将槽位标记为正在写入，
+            // 消费者以acquire语义读到正在写入的标记时，看到的一定是本次占有的记录，而不是槽位上一次被使用时残留的值
+            slot->_owner.store(current_process(), std::memory_order_relaxed);
+            slot->_claim_ns.store(now_ns(), std::memory_order_relaxed);
+            uint64_t expected = pos;
+            if (!slot->_seq.compare_exchange_strong(expected, pos | WRITING_BIT, std::memory_order_release, std::memory_order_relaxed))
+            {
+                _header->_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            size_t len = msg.size() < _header->_slot_size ? msg.size() : _header->_slot_size;
+            memcpy(slot_data(slot), msg.data(), len);
+            slot->_len = len;
+            slot->_level = val;
+            expected = pos | WRITING_BIT;
+            if (!slot->_seq.compare_exchange_strong(expected, pos + 1, std::memory_order_release))
+            {
+                _header->_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            // 与消费者的fence配对：要么消费者在等待前看到了刚发布的槽位，要么这里看到消费者正在等待并唤醒它
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_header->_consumer_waiting.load(std::memory_order_relaxed))
+                wake_consumer();
+            return true;
+        }
+        // 启动消费线程，将共享内存环中的日志按序交给target输出，所有进程中同时只能有一个消费者
+        // 已有其他存活的消费者或当前对象已启动消费线程时返回false
+        bool start_consumer(const LogSink::ptr &target)
+        {
+            std::unique_lock<std::mutex> lock(_consumer_mutex);
+            if (target == nullptr || _consumer.joinable() || !acquire_consumer())
+                return false;
+            _target = target;
+            _stop.store(false, std::memory_order_relaxed);
+            _consumer = std::thread([this]()
+                                    {
+                                        while (!_stop.load(std::memory_order_relaxed))
+                                        {
+                                            if (consume() == 0)
+                                                wait_for_records();
+                                        }
+                                        consume();
+                                        _target->flush(); });
+            return true;
+        }
+        // 停止消费线程，停止前会处理完环中已发布的日志
+        void stop_consumer()
+        {
+            std::unique_lock<std::mutex> lock(_consumer_mutex);
+            if (!_consumer.joinable())
+                return;
+            _stop.store(true, std::memory_order_relaxed);
+            wake_consumer();
+            _consumer.join();
+            _target.reset();
+            uint64_t self = current_process();
+            _header->_consumer.compare_exchange_strong(self, 0);
+        }
+        // 将共享内存环中已发布的日志交给目标落地对象输出，返回处理的槽位数量，只能由消费线程调用
+        size_t consume()
+        {
+            size_t count = 0;
+            uint64_t pos = _header->_dequeue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Slot *slot = slot_at(pos);
+                uint64_t seq = slot->_seq.load(std::memory_order_acquire);
+                if (seq == pos + 1)
+                {
+                    Level::value level = (Level::value)slot->_level;
+                    if (_target->should_log(level))
+                    {
+                        _record.assign(slot_data(slot), slot->_len);
+                        _target->write_record(_record, level);
+                    }
+                    slot->_seq.store(pos + _header->_slot_count, std::memory_order_release);
+                }
+                else if (pos >= _header->_enqueue_pos.load(std::memory_order_acquire) || !recover(slot, pos, seq))
+                    break; // 环为空，或槽位正在被正常写入
+                _stall_start_ns = 0;
+                pos++;
+                count++;
+                _header->_dequeue_pos.store(pos, std::memory_order_relaxed);
+            }
+            return count;
+        }
+        // 因环满或槽位被回收而丢弃的日志条数(所有进程合计)
+        uint64_t dropped() const { return _header->_dropped.load(std::memory_order_relaxed); }
+        // 因写入进程崩溃或卡死而被跳过的槽位数量(所有进程合计)
+        uint64_t recovered() const { return _header->_recovered.load(std::memory_order_relaxed); }
+        std::string name() const override { return "shm:" + _name; }
+        // 根据名称获取共享内存通道，名称对应/dev/shm下的文件名，不能包含'/'
+        // 共享内存不存在时按slot_count和slot_size创建，已存在时直接使用其中记录的参数；失败返回nullptr
+        // 需要在fork之前获取，子进程继承映射后即可直接使用
+        static ShmChannelSink::ptr get_sink(const std::string &name, size_t slot_count = DEFAULT_SHM_SLOT_COUNT,
+                                            size_t slot_size = DEFAULT_SHM_SLOT_SIZE)
+        {
+            if (name.empty() || name.size() > 200 || name.find('/') != std::string::npos || slot_count == 0 || slot_size == 0)
+                return ShmChannelSink::ptr(nullptr);
+            std::unique_lock<std::mutex> shmhash_lock(_shmhash_mutex);
+            if (_shmhash.find(name) != _shmhash.end())
+                return _shmhash[name];
+            ShmChannelSink::ptr tmp(new ShmChannelSink(name, slot_count, slot_size));
+            if (tmp->_header == nullptr)
+                return ShmChannelSink::ptr(nullptr);
+            _shmhash[name] = tmp;
+            return _shmhash[name];
+        }
+        // 删除名称对应的共享内存，已经映射了它的进程不受影响
+        static bool remove(const std::string &name) { return shm_unlink(("/" + name).c_str()) == 0; }
+
+    private:
+        static const uint64_t WRITING_BIT = 1ull << 63; // 槽位序号的最高位，置位表示槽位已被占有、正在写入
+        // 共享内存的头部
+        struct Header
+        {
+            std::atomic<uint64_t> _magic;
+            uint64_t _slot_count;
+            uint64_t _slot_size;
+            uint64_t _slot_stride;
+            std::atomic<uint64_t> _consumer; // 消费者进程的标识(见process_id())，为0表示没有消费者
+            std::atomic<uint64_t> _dropped;
+            std::atomic<uint64_t> _recovered;
+            alignas(64) std::atomic<uint64_t> _enqueue_pos; // 下一个待占有的位置
+            alignas(64) std::atomic<uint64_t> _dequeue_pos; // 下一个待消费的位置，只由消费者修改
+            alignas(64) std::atomic<uint32_t> _wake_seq;    // 消费者等待的futex，生产者唤醒消费者前先将其加1
+            std::atomic<uint32_t> _consumer_waiting;        // 消费者是否正在(或即将)等待新日志
+        };
+        // 每个槽位的头部，其后紧跟日志内容
+        // _seq为pos时槽位可被位置pos的生产者占有，为pos|WRITING_BIT时正在写入，为pos+1时已发布可被消费
+        struct alignas(64) Slot
+        {
+            std::atomic<uint64_t> _seq;
+            std::atomic<uint64_t> _owner;    // 占有该槽位的进程的标识(见process_id())
+            std::atomic<uint64_t> _claim_ns; // 占有该槽位的时间(CLOCK_MONOTONIC，系统范围内一致)
+            uint32_t _len;
+            uint32_t _level;
+        };
+        ShmChannelSink(const std::string &name, size_t slot_count, size_t slot_size) : _name(name)
+        {
+            current_process(); // 在fork之前完成pthread_atfork()的注册
+            std::string shm_name = "/" + name;
+            size_t stride = (sizeof(Slot) + slot_size + 63) / 64 * 64;
+            size_t size = sizeof(Header) + stride * slot_count;
+            int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (fd != -1)
+            {
+                // 创建者负责初始化，初始化完毕后才写入魔数
+                if (ftruncate(fd, size) == -1 || !map(fd, size))
+                {
+                    close(fd);
+                    shm_unlink(shm_name.c_str());
+                    return;
+                }
+                close(fd);
+                _header->_slot_count = slot_count;
+                _header->_slot_size = slot_size;
+                _header->_slot_stride = stride;
+                for (size_t i = 0; i < slot_count; i++)
+                    slot_at(i)->_seq.store(i, std::memory_order_relaxed);
+                _header->_magic.store(SHM_CHANNEL_MAGIC, std::memory_order_release);
+                return;
+            }
+            if (errno != EEXIST || (fd = shm_open(shm_name.c_str(), O_RDWR | O_CLOEXEC, 0644)) == -1)
+                return;
+            // 等待创建者完成初始化，再按共享内存中记录的参数重新映射
+            struct stat st;
+            uint64_t deadline = now_ns() + SHM_ATTACH_TIMEOUT_MS * 1000000ull;
+            while (fstat(fd, &st) == 0 && (size_t)st.st_size < sizeof(Header) && now_ns() < deadline)
+                usleep(1000);
+            if ((size_t)st.st_size >= sizeof(Header) && map(fd, sizeof(Header)))
+            {
+                while (_header->_magic.load(std::memory_order_acquire) != SHM_CHANNEL_MAGIC && now_ns() < deadline)
+                    usleep(1000);
+                size = sizeof(Header) + _header->_slot_stride * _header->_slot_count;
+                bool ok = _header->_magic.load(std::memory_order_acquire) == SHM_CHANNEL_MAGIC && fstat(fd, &st) == 0 && (size_t)st.st_size >= size;
+                munmap(_header, _map_size);
+                _header = nullptr;
+                if (ok)
+                    map(fd, size);
+            }
+            close(fd);
+        }
+        ShmChannelSink(const ShmChannelSink &tp) = delete;
+        ShmChannelSink &operator=(const ShmChannelSink &tp) = delete;
+        bool map(int fd, size_t size)
+        {
+            void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED)
+                return false;
+            _header = (Header *)addr;
+            _map_size = size;
+            return true;
+        }
+        Slot *slot_at(uint64_t pos) const
+        {
+            return (Slot *)((char *)_header + sizeof(Header) + (pos % _header->_slot_count) * _header->_slot_stride);
+        }
+        static char *slot_data(Slot *slot) { return (char *)slot + sizeof(Slot); }
+        static uint64_t now_ns()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        }
+        static long futex(std::atomic<uint32_t> *addr, int op, uint32_t val, const struct timespec *timeout)
+        {
+            // 共享内存被多个进程映射，不能使用FUTEX_PRIVATE_FLAG
+            return syscall(SYS_futex, (uint32_t *)addr, op, val, timeout, nullptr, 0);
+        }
+        // 消费线程没有日志可处理时等待生产者唤醒，最多等待SHM_CONSUMER_IDLE_MS
+        void wait_for_records()
+        {
+            uint32_t seq = _header->_wake_seq.load(std::memory_order_acquire);
+            _header->_consumer_waiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // 标记等待状态之后再检查一次，避免错过在标记之前发布的日志
+            if (!_stop.load(std::memory_order_relaxed) && !has_published())
+            {
+                struct timespec timeout = {SHM_CONSUMER_IDLE_MS / 1000, (SHM_CONSUMER_IDLE_MS % 1000) * 1000000L};
+                futex(&_header->_wake_seq, FUTEX_WAIT, seq, &timeout);
+            }
+            _header->_consumer_waiting.store(0, std::memory_order_relaxed);
+        }
+        void wake_consumer()
+        {
+            _header->_wake_seq.fetch_add(1, std::memory_order_release);
+            futex(&_header->_wake_seq, FUTEX_WAKE, 1, nullptr);
+        }
+        // 下一个待消费的槽位是否已发布
+        bool has_published() const
+        {
+            uint64_t pos = _header->_dequeue_pos.load(std::memory_order_relaxed);
+            return slot_at(pos)->_seq.load(std::memory_order_acquire) == pos + 1;
+        }
+        // 进程的标识：高32位为进程ID，低32位为进程启动时间的低32位，启动时间无法读取时低32位为0
+        // 进程ID和启动时间放在同一个原子变量中，其他进程读取时不会看到一个进程的ID配上另一个进程的启动时间
+        static uint64_t process_id(int pid) { return (uint64_t)(uint32_t)pid << 32 | (uint32_t)process_start_time(pid); }
+        // 获取当前进程的标识，通过pthread_atfork()在fork后的子进程中更新缓存，避免每条日志都读取/proc
+        static std::atomic<uint64_t> &process_cache()
+        {
+            static std::atomic<uint64_t> id(process_id(getpid()));
+            static int registered = pthread_atfork(nullptr, nullptr, []()
+                                                   { process_cache().store(process_id(getpid()), std::memory_order_relaxed); });
+            (void)registered;
+            return id;
+        }
+        static uint64_t current_process() { return process_cache().load(std::memory_order_relaxed); }
+        // 读取进程的启动时间(系统启动后经过的时钟周期数)，进程不存在或无法读取时返回0，不分配内存，可以在fork后的子进程中调用
+        static uint64_t process_start_time(int pid)
+        {
+            char buf[1024];
+            snprintf(buf, sizeof(buf), "/proc/%d/stat", pid);
+            int fd = open(buf, O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+                return 0;
+            ssize_t n = read(fd, buf, sizeof(buf) - 1);
+            close(fd);
+            if (n <= 0)
+                return 0;
+            buf[n] = '\0';
+            // 第2项为括号括起来的进程名，其中可能包含空格，因此从最后一个')'之后开始数：其后依次是第3项到第22项
+            char *p = strrchr(buf, ')');
+            for (int field = 2; p != nullptr && field < 22; field++)
+                p = strchr(p + 1, ' ');
+            return p == nullptr ? 0 : strtoull(p + 1, nullptr, 10);
+        }
+        // 判断标识为id的进程是否仍然存在：进程ID存在且启动时间一致，ID被新进程复用时启动时间不同
+        static bool process_alive(uint64_t id)
+        {
+            int pid = (int)(id >> 32);
+            if (pid <= 0 || (kill(pid, 0) == -1 && errno == ESRCH))
+                return false;
+            uint32_t start = (uint32_t)id;
+            if (start == 0) // 记录时无法读取启动时间，只能按进程ID判断
+                return true;
+            uint64_t cur = process_start_time(pid);
+            return cur == 0 || (uint32_t)cur == start; // 读取失败(如/proc不可用)时按存在处理
+        }
+        // 成为唯一的消费者，之前的消费者进程已不存在时接管
+        bool acquire_consumer()
+        {
+            uint64_t self = current_process();
+            uint64_t cur = _header->_consumer.load(std::memory_order_acquire);
+            while (true)
+            {
+                if (cur == self || (cur != 0 && process_alive(cur)))
+                    return false;
+                if (_header->_consumer.compare_exchange_weak(cur, self, std::memory_order_acq_rel))
+                    return true;
+            }
+        }
+        // 处理已被占有但尚未发布的槽位，占有者已崩溃或卡死时通过CAS将其标记为已消费并返回true
+        bool recover(Slot *slot, uint64_t pos, uint64_t seq)
+        {
+            if (seq != pos && seq != (pos | WRITING_BIT))
+                return false;
+            uint64_t now = now_ns();
+            if (_stall_start_ns == 0)
+                _stall_start_ns = now;
+            bool abandoned;
+            if (seq == pos) // 生产者推进了写位置但还没来得及标记槽位，无法得知占有者，只能按超时判断
+                abandoned = now - _stall_start_ns >= SHM_STALL_TIMEOUT_MS * 1000000ull;
+            else
+                abandoned = !process_alive(slot->_owner.load(std::memory_order_relaxed)) ||
+                            now - slot->_claim_ns.load(std::memory_order_relaxed) >= SHM_STALL_TIMEOUT_MS * 1000000ull;
+            if (!abandoned || !slot->_seq.compare_exchange_strong(seq, pos + _header->_slot_count, std::memory_order_acq_rel))
+                return false;
+            _header->_recovered.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        std::string _name;              // 共享内存的名称
+        Header *_header = nullptr;      // 映射的共享内存的起始地址，映射失败时为nullptr
+        size_t _map_size = 0;           // 映射的共享内存的大小
+        std::mutex _consumer_mutex;     // 保证启动和停止消费线程时的线程安全
+        std::thread _consumer;          // 消费线程
+        std::atomic<bool> _stop{false}; // 消费线程的停止标志
+        LogSink::ptr _target;           // 消费线程输出日志的目标落地对象
+        uint64_t _stall_start_ns = 0;   // 消费者开始等待当前未发布槽位的时间，只由消费线程使用
+        std::string _record;            // 消费线程复用的日志字符串，只由消费线程使用
+
+        static std::unordered_map<std::string, ShmChannelSink::ptr> _shmhash; // 进程内所有的ShmChannelSink对象交给_shmhash统一管理，以共享内存名称作为唯一标识
+        static std::mutex _shmhash_mutex;                                     // 保证多线程操作_shmhash时的线程安全
+    };
+    std::unordered_map<std::string, ShmChannelSink::ptr> ShmChannelSink::_shmhash;
+    std::mutex ShmChannelSink::_shmhash_mutex;
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef LOG_SYSTEM_SIMD_HPP
+#define LOG_SYSTEM_SIMD_HPP
+
+#include <string.h>
+#include <stddef.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define LOG_SYSTEM_HAVE_AVX2 1 // 编译器支持通过target属性单独为部分函数生成AVX2指令，运行时再根据CPU是否支持决定是否调用
+#endif
+
+namespace log_system
+{
+    // 向量化工具模块，为日志查询、日志消息转义等需要扫描大块文本的功能提供SIMD加速的实现，不支持SSE2的平台自动使用标量实现
+    namespace Simd
+    {
+        // 在[hay, hay + n)中查找needle第一次出现的位置，找不到时返回n
+        // SSE2实现每次比较16个候选位置：同时匹配needle的首字节和尾字节的位置才用memcmp()确认，绝大多数不匹配的数据只需两次向量比较即可跳过
+        size_t find(const char *hay, size_t n, const char *needle, size_t m)
+        {
+            if (m == 0)
+                return 0;
+            if (m > n)
+                return n;
+            size_t i = 0;
+#if defined(__SSE2__)
+            const __m128i first = _mm_set1_epi8(needle[0]);
+            const __m128i last = _mm_set1_epi8(needle[m - 1]);
+            for (; i + m - 1 + 16 <= n; i += 16)
+            {
+                __m128i block_first = _mm_loadu_si128((const __m128i *)(hay + i));
+                __m128i block_last = _mm_loadu_si128((const __m128i *)(hay + i + m - 1));
+                unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+                while (mask != 0)
+                {
+                    size_t bit = __builtin_ctz(mask);
+                    if (memcmp(hay + i + bit, needle, m) == 0)
+                        return i + bit;
+                    mask &= mask - 1;
+                }
+            }
+#endif
+            for (; i + m <= n; i++)
+            {
+                if (hay[i] == needle[0] && memcmp(hay + i, needle, m) == 0)
+                    return i;
+            }
+            return n;
+        }
+
+        // 以下函数在[p, p + n)中查找第一个需要转义的字节，返回其偏移，没有时返回n
+        // json为false时查找控制字符(小于0x20的字节和0x7F)，用于清理日志消息，防止通过换行等字符伪造日志；
+        // json为true时还需查找'"'和'\\'，用于将日志消息输出为JSON字符串；大于等于0x80的字节(UTF-8多字节字符)不需要转义
+        inline bool need_escape(unsigned char c, bool json) { return c < 0x20 || c == 0x7F || (json && (c == '"' || c == '\\')); }
+        // 标量实现，逐字节检查
+        size_t find_escape_scalar(const char *p, size_t n, bool json)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                if (need_escape((unsigned char)p[i], json))
+                    return i;
+            }
+            return n;
+        }
+#if defined(__SSE2__)
+        // SSE2实现，每次检查16字节：max_epu8(v, 0x1F) == 0x1F即v <= 0x1F(无符号比较)，再与0x7F以及JSON的两个字符的比较结果合并
+        size_t find_escape_sse2(const char *p, size_t n, bool json)
+        {
+            const __m128i ctrl = _mm_set1_epi8(0x1F), del = _mm_set1_epi8(0x7F);
+            const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+                __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl), _mm_cmpeq_epi8(v, del));
+                if (json)
+                    hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+                unsigned mask = _mm_movemask_epi8(hit);
+                if (mask != 0)
+                    return i + __builtin_ctz(mask);
+            }
+            return i + find_escape_scalar(p + i, n - i, json);
+        }
+#endif
+#if defined(LOG_SYSTEM_HAVE_AVX2)
+        // AVX2实现，每次检查32字节，只有运行时确认CPU支持AVX2后才会被调用
+        __attribute__((target("avx2"))) size_t find_escape_avx2(const char *p, size_t n, bool json)
+        {
+            const __m256i ctrl = _mm256_set1_epi8(0x1F), del = _mm256_set1_epi8(0x7F);
+            const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\');
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+                __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrl), ctrl), _mm256_cmpeq_epi8(v, del));
+                if (json)
+                    hit = _mm256_or_si256(hit, _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)));
+                unsigned mask = _mm256_movemask_epi8(hit);
+                if (mask != 0)
+                    return i + __builtin_ctz(mask);
+            }
+            return i + find_escape_scalar(p + i, n - i, json);
+        }
+#endif
+        using FindEscapeFunc = size_t (*)(const char *, size_t, bool);
+        // 根据CPU支持的指令集选择最快的实现，只在第一次调用时检测
+        FindEscapeFunc best_find_escape()
+        {
+            static const FindEscapeFunc func = []() -> FindEscapeFunc
+            {
+#if defined(LOG_SYSTEM_HAVE_AVX2)
+                if (__builtin_cpu_supports("avx2"))
+                    return find_escape_avx2;
+#endif
+#if defined(__SSE2__)
+                return find_escape_sse2;
+#else
+                return find_escape_scalar;
+#endif
+            }();
+            return func;
+        }
+        // 查找第一个需要转义的字节，自动使用当前CPU支持的最快的实现
+        inline size_t find_escape(const char *p, size_t n, bool json) { return best_find_escape()(p, n, json); }
+    }
+}
+
+#endif
@@ -2,15 +2,30 @@
 #define LOG_SYSTEM_SINK_HPP
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string.h>
 #include <string>
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <time.h>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <condition_variable>
 #include <unordered_map>
+#include "level.hpp"
+#include "metrics.hpp"
 #include "util.hpp"
+#include "log_index.hpp"
 
 namespace log_system
 {
@@ -18,12 +33,55 @@ namespace log_system
     // 日志落地基类,将来子类通过重写log()函数实现不同的日志落地方向
     // 所有日志落地的对象内部自行保证多线程使用同一对象进行落地时的线程安全,即保证了多线程使用同一对象在调用log()函数进行日志落地时的线程安全
     // 日志落地对象根据日志落地的位置保证全局唯一性,所有的日志落地对象都不可以直接创建使用，必须由每个类的静态成员函数get_sink()进行创建和获取，如果get_sink()返回nullptr就表示获取失败
+    // 每个日志落地对象都可以设置自己接收的最低日志等级，日志器在格式化和放入异步缓冲区之前就会跳过该落地对象不接收的日志
     class LogSink
     {
     public:
         using ptr = std::shared_ptr<LogSink>;
         virtual bool log(const std::string &msg) = 0;
+        // 携带日志等级的落地接口，日志器实际调用的是该接口，默认忽略等级直接调用log(msg)，需要根据等级做特殊处理的子类可重写该函数
+        virtual bool log(const std::string &msg, Level::value) { return log(msg); }
+        // 将已经交给该落地对象的日志持久化(如同步到磁盘)，默认无需任何操作，成功返回true
+        virtual bool flush() { return true; }
         virtual ~LogSink() {};
+        // 设置该落地对象接收的最低日志等级，由于落地对象全局唯一，该设置对所有使用该落地对象的日志器都生效
+        void set_level(Level::value val) { _min_level.store(val, std::memory_order_relaxed); }
+        Level::value get_level() const { return _min_level.load(std::memory_order_relaxed); }
+        // 判断该落地对象是否接收val等级的日志
+        bool should_log(Level::value val) const { return val >= _min_level.load(std::memory_order_relaxed); }
+        // 落地对象的名称，用于统计数据中区分不同的落地对象
+        virtual std::string name() const { return "sink"; }
+        // 带统计的落地接口，日志器和异步工作线程通过该接口调用log(msg, val)，同时记录落地的条数、字节数、错误数和耗时
+        bool write_record(const std::string &msg, Level::value val)
+        {
+            auto start = std::chrono::steady_clock::now();
+            bool ret = log(msg, val);
+            auto end = std::chrono::steady_clock::now();
+            _write_latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            _records.add();
+            _bytes.add(msg.size());
+            if (!ret)
+                _errors.add();
+            return ret;
+        }
+        // 获取该落地对象的统计数据快照
+        SinkMetricsSnapshot metrics() const
+        {
+            SinkMetricsSnapshot snap;
+            snap._name = name();
+            snap._records = _records.value();
+            snap._bytes = _bytes.value();
+            snap._errors = _errors.value();
+            snap._write = _write_latency.snapshot();
+            return snap;
+        }
+
+    protected:
+        std::atomic<Level::value> _min_level{Level::value::DEBUG}; // 该落地对象接收的最低日志等级
+        ShardedCounter _records;                                   // 落地的日志条数
+        ShardedCounter _bytes;                                     // 落地的总字节数
+        ShardedCounter _errors;                                    // 落地失败的次数
+        Histogram _write_latency;                                  // 每次落地的耗时
     };
     // 标准输出落地类，将日志输出到标准输出中
     class StdoutSink : public LogSink
@@ -39,6 +97,7 @@ namespace log_system
             std::cout << msg << std::flush;
             return std::cout.good();
         }
+        std::string name() const override { return "stdout"; }
         static StdoutSink::ptr get_sink()
         {
             static StdoutSink::ptr sink(new StdoutSink());
@@ -54,74 +113,366 @@ namespace log_system
         std::mutex _mutex; // 互斥锁，用于保证同一对象多线程下调用log()函数时的线程安全
     };
 
+    // 控制台落地类，不经过iostream，直接通过文件描述符向标准输出/标准错误写入，并使用自己的缓冲区和刷新策略
+    // 输出目标为终端时可按日志等级为日志添加ANSI颜色；CONSOLE_SPLIT目标将WARN及以上的日志输出到标准错误，其余输出到标准输出
+    // 每种输出目标全局只有一个对象，刷新策略和是否启用颜色只在第一次创建时生效
+    // 注意：与StdoutSink或其他直接使用标准输出的代码混用时，两者输出的先后顺序取决于各自的刷新时机
+    enum ConsoleTarget
+    {
+        CONSOLE_STDOUT = 0,
+        CONSOLE_STDERR,
+        CONSOLE_SPLIT
+    };
+    // 控制台落地的刷新策略
+    enum ConsoleFlushPolicy
+    {
+        FLUSH_EVERY_RECORD = 0, // 每条日志都立即写入
+        FLUSH_WHEN_FULL         // 缓冲区满、遇到WARN及以上的日志、距上次写入超过CONSOLE_FLUSH_INTERVAL_MS或调用flush()时才写入
+    };
+    class ConsoleSink : public LogSink
+    {
+#define CONSOLE_BUFFER_SIZE (64 * 1024) // 控制台落地缓冲区的大小
+#define CONSOLE_FLUSH_INTERVAL_MS 100   // FLUSH_WHEN_FULL策略下缓冲区中的日志最长的滞留时间(在下一条日志到来时检查)
+    public:
+        using ptr = std::shared_ptr<ConsoleSink>;
+        ~ConsoleSink() { flush(); }
+        bool log(const std::string &msg) override { return log(msg, Level::value::OFF); }
+        bool log(const std::string &msg, Level::value val) override
+        {
+            if (_target == CONSOLE_SPLIT)
+                return val >= Level::value::WARN && val != Level::value::OFF ? _err->log(msg, val) : _out->log(msg, val);
+            std::unique_lock<std::mutex> lock(_mutex);
+            const char *color = _color ? level_color(val) : nullptr;
+            if (_buffer.size() + msg.size() + 16 > CONSOLE_BUFFER_SIZE && !flush_buffer())
+                return false;
+            if (color == nullptr)
+                _buffer += msg;
+            else
+            {
+                bool newline = !msg.empty() && msg.back() == '\n';
+                _buffer += color;
+                _buffer.append(msg, 0, newline ? msg.size() - 1 : msg.size());
+                _buffer += "\033[0m";
+                if (newline)
+                    _buffer += '\n';
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (_policy == FLUSH_EVERY_RECORD || _buffer.size() >= CONSOLE_BUFFER_SIZE ||
+                (val >= Level::value::WARN && val != Level::value::OFF) ||
+                now - _last_flush >= std::chrono::milliseconds(CONSOLE_FLUSH_INTERVAL_MS))
+                return flush_buffer();
+            return true;
+        }
+        bool flush() override
+        {
+            if (_target == CONSOLE_SPLIT)
+                return _out->flush() & _err->flush();
+            std::unique_lock<std::mutex> lock(_mutex);
+            return flush_buffer();
+        }
+        std::string name() const override
+        {
+            return _target == CONSOLE_STDOUT ? "console:stdout" : (_target == CONSOLE_STDERR ? "console:stderr" : "console:split");
+        }
+        static ConsoleSink::ptr get_sink(ConsoleTarget target = CONSOLE_STDOUT, ConsoleFlushPolicy policy = FLUSH_EVERY_RECORD, bool color = true)
+        {
+            if (target < CONSOLE_STDOUT || target > CONSOLE_SPLIT)
+                return ConsoleSink::ptr(nullptr);
+            std::unique_lock<std::mutex> consoles_lock(_consoles_mutex);
+            return get_sink_locked(target, policy, color);
+        }
+
+    private:
+        ConsoleSink(ConsoleTarget target, ConsoleFlushPolicy policy, bool color)
+            : _target(target), _policy(policy), _last_flush(std::chrono::steady_clock::now())
+        {
+            _fd = target == CONSOLE_STDERR ? STDERR_FILENO : STDOUT_FILENO;
+            _color = color && target != CONSOLE_SPLIT && isatty(_fd) == 1;
+            if (target != CONSOLE_SPLIT)
+                _buffer.reserve(CONSOLE_BUFFER_SIZE);
+        }
+        ConsoleSink(const ConsoleSink &tp) = delete;
+        ConsoleSink &operator=(const ConsoleSink &tp) = delete;
+        static ConsoleSink::ptr get_sink_locked(ConsoleTarget target, ConsoleFlushPolicy policy, bool color)
+        {
+            if (_consoles[target] != nullptr)
+                return _consoles[target];
+            ConsoleSink::ptr tmp(new ConsoleSink(target, policy, color));
+            if (target == CONSOLE_SPLIT)
+            {
+                tmp->_out = get_sink_locked(CONSOLE_STDOUT, policy, color);
+                tmp->_err = get_sink_locked(CONSOLE_STDERR, policy, color);
+            }
+            _consoles[target] = tmp;
+            return tmp;
+        }
+        // 各日志等级对应的ANSI颜色，不带等级的日志不添加颜色
+        static const char *level_color(Level::value val)
+        {
+            switch (val)
+            {
+            case Level::value::DEBUG:
+                return "\033[36m";
+            case Level::value::INFO:
+                return "\033[32m";
+            case Level::value::WARN:
+                return "\033[33m";
+            case Level::value::ERROR:
+                return "\033[31m";
+            case Level::value::FATAL:
+                return "\033[1;31m";
+            default:
+                return nullptr;
+            }
+        }
+        // 将缓冲区中的内容写入文件描述符，调用前需加锁
+        bool flush_buffer()
+        {
+            _last_flush = std::chrono::steady_clock::now();
+            if (_buffer.empty())
+                return true;
+            bool ret = Util::write_all(_fd, _buffer.data(), _buffer.size());
+            _buffer.clear();
+            return ret;
+        }
+
+    private:
+        ConsoleTarget _target;                                // 输出目标
+        ConsoleFlushPolicy _policy;                           // 刷新策略
+        int _fd;                                              // 输出的文件描述符
+        bool _color;                                          // 是否为日志添加颜色
+        std::mutex _mutex;                                    // 互斥锁，保护缓冲区的线程安全
+        std::string _buffer;                                  // 尚未写入的日志
+        std::chrono::steady_clock::time_point _last_flush;    // 上一次写入的时间
+        ConsoleSink::ptr _out;                                // CONSOLE_SPLIT目标使用的标准输出落地对象
+        ConsoleSink::ptr _err;                                // CONSOLE_SPLIT目标使用的标准错误落地对象
+        static ConsoleSink::ptr _consoles[CONSOLE_SPLIT + 1]; // 每种输出目标全局唯一的ConsoleSink对象
+        static std::mutex _consoles_mutex;                    // 保证多线程操作_consoles时的线程安全
+    };
+    ConsoleSink::ptr ConsoleSink::_consoles[CONSOLE_SPLIT + 1];
+    std::mutex ConsoleSink::_consoles_mutex;
+
+    // 共享文件类，同一个文件全局只打开一次，所有写入该文件的落地对象(FileSink以及RollFileSinkBySize当前的滚动文件)共享同一个文件描述符
+    // 由静态成员函数get()按文件的绝对路径获取，最后一个使用者释放后自动关闭文件
+    // 文件大小在打开时通过fstat()获取，之后由每次写入累加，不统计其他进程对该文件的写入
+    class SharedFile
+    {
+    public:
+        using ptr = std::shared_ptr<SharedFile>;
+        ~SharedFile()
+        {
+            if (_fd != -1)
+                close(_fd);
+        }
+        // 将len字节的数据写入文件，sync为真时再调用fsync()同步到磁盘，多个落地对象同时写入同一文件时由内部的互斥锁保证每条日志完整写入
+        bool write(const char *data, size_t len, bool sync)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!Util::write_all(_fd, data, len))
+                return false;
+            _size.fetch_add(len, std::memory_order_relaxed);
+            if (sync && fsync(_fd) == -1)
+                return false;
+            return true;
+        }
+        // 将已写入的数据同步到磁盘
+        bool sync() { return fsync(_fd) == 0; }
+        // 获取文件的当前大小(以字节为单位)
+        long long size() const { return _size.load(std::memory_order_relaxed); }
+        // 获取absolute_path对应的共享文件，尚未打开时先确保所在目录存在，再以追加方式打开，失败返回nullptr
+        static SharedFile::ptr get(const std::string &absolute_path)
+        {
+            std::unique_lock<std::mutex> files_lock(_files_mutex);
+            auto it = _files.find(absolute_path);
+            if (it != _files.end())
+            {
+                SharedFile::ptr file = it->second.lock();
+                if (file != nullptr)
+                    return file;
+            }
+            int fd = open_append(absolute_path);
+            if (fd == -1)
+                return SharedFile::ptr(nullptr);
+            struct stat att;
+            long long size = fstat(fd, &att) == 0 ? att.st_size : 0;
+            // 打开新文件的频率很低，顺便清理已经关闭的文件留下的表项，避免滚动文件不断产生新表项
+            for (auto iter = _files.begin(); iter != _files.end();)
+                iter = iter->second.expired() ? _files.erase(iter) : ++iter;
+            SharedFile::ptr file(new SharedFile(fd, size));
+            _files[absolute_path] = file;
+            return file;
+        }
+
+    private:
+        SharedFile(int fd, long long size) : _fd(fd), _size(size) {}
+        SharedFile(const SharedFile &tp) = delete;
+        SharedFile &operator=(const SharedFile &tp) = delete;
+        // 以追加方式打开文件，所在目录的存在性检查走Util::create_dir()的缓存
+        // 若目录在缓存之后被外部删除导致打开失败，则清空缓存重新创建目录后再尝试一次
+        static int open_append(const std::string &absolute_path)
+        {
+            std::string dir = Util::file_dir(absolute_path);
+            if (!Util::create_dir(dir))
+                return -1;
+            int fd = open(absolute_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd == -1 && errno == ENOENT)
+            {
+                Util::forget_dirs();
+                if (Util::create_dir(dir))
+                    fd = open(absolute_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            }
+            return fd;
+        }
+
+    private:
+        int _fd = -1;                 // 打开的文件的文件描述符
+        std::mutex _mutex;            // 互斥锁，保证多个落地对象同时写入时每条日志的完整性
+        std::atomic<long long> _size; // 文件的当前大小
+
+        static std::unordered_map<std::string, std::weak_ptr<SharedFile>> _files; // 以文件的绝对路径为键管理所有已打开的文件，只持有弱引用，文件的生命周期由使用它的落地对象决定
+        static std::mutex _files_mutex;                                          // 保证多线程操作_files时的线程安全
+    };
+    std::unordered_map<std::string, std::weak_ptr<SharedFile>> SharedFile::_files;
+    std::mutex SharedFile::_files_mutex;
+
     // 指定文件落地类，将日志输出到指定的文件中
+    // 创建对象时只将路径转化为绝对路径，不创建目录也不打开文件，直到第一次写入日志时才打开文件，因此启动时注册大量文件的开销很小
+    // 打开失败时本次写入返回false，下一次写入时重新尝试打开；多个落地对象写入同一文件时共享同一个文件描述符(见SharedFile)
+    // FileSink和RollFileSinkBySize共用一张以"类型:绝对路径"为键的注册表来保证全局唯一性
     class FileSink : public LogSink
     {
     public:
         using ptr = std::shared_ptr<FileSink>;
-        ~FileSink()
-        {
-            if (_ofs.is_open())
-                _ofs.close();
-        }
+        ~FileSink() = default;
         virtual bool log(const std::string &msg) override
         {
             std::unique_lock<std::mutex> lock(_mutex);
-            if (!_state || !_ofs.good())
+            if (_file == nullptr && !open_file(_path))
                 return false;
-            _ofs << msg << std::flush;
-            return _ofs.good();
+            return _file->write(msg.data(), msg.size(), _sync.load(std::memory_order_relaxed));
         }
+        // 将已写入的日志同步到磁盘，尚未写入过日志时直接返回真
+        bool flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_file == nullptr)
+                return true;
+            return _file->sync();
+        }
+        // 设置是否在每次写入后都调用fsync()将日志同步到磁盘，用于ERROR等不能丢失的日志
+        void set_sync(bool sync) { _sync.store(sync, std::memory_order_relaxed); }
+        std::string name() const override { return "file:" + _path; }
+        // 只在路径不合法时返回nullptr，文件在第一次写入时才打开
         static FileSink::ptr get_sink(const std::string &path)
         {
             std::string absolute_path = Util::path_transform(path);
             if (absolute_path == "")
                 return FileSink::ptr(nullptr);
-            std::unique_lock<std::mutex> filehash_lock(_filehash_mutex);
-            if (_filehash.find(absolute_path) != _filehash.end())
-                return _filehash[absolute_path];
-            FileSink::ptr tmp(new FileSink(absolute_path));
-            if (tmp->_state == false)
-                return FileSink::ptr(nullptr);
-            _filehash[absolute_path] = tmp;
-            return _filehash[absolute_path];
+            std::unique_lock<std::mutex> sinks_lock(_sinks_mutex);
+            FileSink::ptr &sink = _sinks["file:" + absolute_path];
+            if (sink == nullptr)
+                sink.reset(new FileSink(absolute_path));
+            return sink;
         }
 
     protected:
         FileSink() = default;
         FileSink(const FileSink &tp) = delete;
         FileSink &operator=(const FileSink &tp) = delete;
-        FileSink(const std::string &path)
+        FileSink(const std::string &absolute_path) : _path(absolute_path) {}
+        // 获取path对应的共享文件作为当前写入的文件，调用前需加锁
+        bool open_file(const std::string &path)
         {
-            std::string absolute_path = Util::path_transform(path);
-            if (absolute_path == "")
-                _state = false;
-            // 判断文件所在路径是否存在，不存在就先创建
-            if (_state)
-                _state = Util::create_dir(Util::file_dir(absolute_path));
-            if (_state)
-            {
-                _ofs.open(absolute_path, std::ios::binary | std::ios::app);
-                _state = _ofs.is_open();
-            }
+            _file = SharedFile::get(path);
+            return _file != nullptr;
         }
 
     protected:
-        std::mutex _mutex;  // 互斥锁，用于保证同一对象多线程下调用log()函数时的线程安全
-        std::ofstream _ofs; // 文件流对象，用于管理打开的文件
-        bool _state = true; // 状态标志位，标识当前对象的状态
+        std::mutex _mutex;              // 互斥锁，用于保证同一对象多线程下调用log()函数时的线程安全
+        std::string _path;              // 创建该对象时传入的文件的绝对路径
+        SharedFile::ptr _file;          // 当前写入的文件，尚未打开时为nullptr
+        std::atomic<bool> _sync{false}; // 是否每次写入后都同步到磁盘
+
+        static std::unordered_map<std::string, FileSink::ptr> _sinks; // 全局范围内的所有FileSink和RollFileSinkBySize对象交给_sinks统一管理，键为"file:"或"roll:"加上绝对路径
+        static std::mutex _sinks_mutex;                               // 保证多线程操作_sinks时的线程安全
+    };
+    std::unordered_map<std::string, FileSink::ptr> FileSink::_sinks;
+    std::mutex FileSink::_sinks_mutex;
+
+    // 滚动文件的索引建立器，在后台线程中依次为写满的滚动文件建立稀疏索引(见LogIndex)，写入日志的线程滚动时只需提交任务
+    // 对象和后台线程在第一次提交任务时创建，之后一直存在直到进程退出，不随进程退出而析构，避免退出时等待或终止正在建立索引的线程；
+    // 进程退出时尚未建立的索引可以之后通过logquery --build补建。fork()出的子进程中没有后台线程，第一次提交任务时重新创建
+    class IndexBuilder
+    {
+    public:
+        // 提交一个为path建立索引的任务，立即返回
+        static void submit(const std::string &path, const std::string &fmt_str)
+        {
+            IndexBuilder &builder = instance();
+            std::unique_lock<std::mutex> lock(builder._mutex);
+            builder._tasks.emplace_back(path, fmt_str);
+            builder._cond.notify_one();
+        }
+        // 阻塞等待直到当前进程中已提交的索引全部建立完成
+        static void wait()
+        {
+            IndexBuilder &builder = instance();
+            std::unique_lock<std::mutex> lock(builder._mutex);
+            builder._idle_cond.wait(lock, [&]()
+                                    { return builder._tasks.empty() && !builder._building; });
+        }
 
     private:
-        static std::unordered_map<std::string, FileSink::ptr> _filehash; // 全局范围内的所有FileSink对象交给_filehash统一管理，以保证FileSink对象全局范围内的唯一性
-        static std::mutex _filehash_mutex;                               // 保证多线程操作_filehash时的线程安全
+        IndexBuilder() : _pid(getpid()) {}
+        static IndexBuilder &instance()
+        {
+            static std::atomic<IndexBuilder *> builder{nullptr};
+            IndexBuilder *cur = builder.load(std::memory_order_acquire);
+            while (cur == nullptr || cur->_pid != getpid())
+            {
+                IndexBuilder *tmp = new IndexBuilder();
+                if (builder.compare_exchange_strong(cur, tmp, std::memory_order_acq_rel))
+                {
+                    std::thread(&IndexBuilder::run, tmp).detach();
+                    return *tmp;
+                }
+                delete tmp;
+            }
+            return *cur;
+        }
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true)
+            {
+                _cond.wait(lock, [&]()
+                           { return !_tasks.empty(); });
+                auto task = std::move(_tasks.front());
+                _tasks.pop_front();
+                _building = true;
+                lock.unlock();
+                LogIndex::build(task.first, task.second);
+                lock.lock();
+                _building = false;
+                if (_tasks.empty())
+                    _idle_cond.notify_all();
+            }
+        }
+
+    private:
+        const pid_t _pid;                                        // 创建该对象(及后台线程)的进程
+        std::mutex _mutex;                                       // 保护_tasks和_building
+        std::condition_variable _cond;                           // 后台线程在该条件变量下等待任务
+        std::condition_variable _idle_cond;                      // wait()在该条件变量下等待所有任务完成
+        std::deque<std::pair<std::string, std::string>> _tasks; // 尚未开始的任务，每项为日志文件路径和格式化字符串
+        bool _building = false;                                  // 后台线程是否正在建立索引
     };
-    std::unordered_map<std::string, FileSink::ptr> FileSink::_filehash;
-    std::mutex FileSink::_filehash_mutex;
 
-    // 滚动文件落地类 \
-    根据传入的基础文件名和最大大小限制，先将基础文件名结合当前时间（以秒为单位）形成完整的文件名，再将日志输出到该文件中\
-    当前时间与日志目标输出文件的创建时间在同一秒内，则日志文件不发生滚动，不在同一秒内且日志文件超过最大大小限制才触发滚动\
-    滚动后又以当前时间结合基础文件名创建新的文件，再将日志输出到新的文件中
+    // 滚动文件落地类
+    // 根据传入的基础文件名和最大大小限制，先将基础文件名结合当前时间（以秒为单位）形成完整的文件名，再将日志输出到该文件中
+    // 当前时间与日志目标输出文件的创建时间在同一秒内，则日志文件不发生滚动，不在同一秒内且日志文件超过最大大小限制才触发滚动
+    // 滚动后又以当前时间结合基础文件名创建新的文件，再将日志输出到新的文件中
+    // 与FileSink相同，第一次写入日志时才创建第一个滚动文件；文件大小由SharedFile在写入时累加，不需要每条日志都调用stat()
     class RollFileSinkBySize : public FileSink
     {
 #define DEFAULT_MAX_SIZE (1024 * 1024) // 滚动文件默认的最大大小
@@ -131,66 +482,51 @@ namespace log_system
         bool log(const std::string &msg) override
         {
             std::unique_lock<std::mutex> lock(_mutex);
-            if (!_state || !_ofs.good())
-                return false;
-            long long fsize = get_file_size();
-            if (fsize == -1)
-                return false;
-            else if (fsize >= _max_size && _last_time != time(nullptr))
+            if (_file == nullptr || (_file->size() >= _max_size && _last_time != time(nullptr)))
             {
+                if (_file != nullptr && !_index_fmt.empty())
+                    IndexBuilder::submit(_cur_filename, _index_fmt);
+                _file.reset();
                 _cur_filename = get_filename_by_time();
-                _ofs.close();
-                _ofs.open(_cur_filename, std::ios::binary | std::ios::app);
-                _state = _ofs.is_open();
+                if (!open_file(_cur_filename))
+                    return false;
             }
-            if (!_state || !_ofs.good())
+            return _file->write(msg.data(), msg.size(), _sync.load(std::memory_order_relaxed));
+        }
+        std::string name() const override { return "roll:" + _path; }
+        // 设置写入该落地对象的日志使用的格式化字符串，之后每次滚动时都会为写满的文件建立稀疏索引(见LogIndex)，供logquery工具查询
+        // 索引由IndexBuilder在后台线程中建立，不阻塞写入日志的线程；格式化字符串不能按行解析时返回false，为空则关闭该功能
+        bool set_index_format(const std::string &fmt_str)
+        {
+            if (!fmt_str.empty() && !LogFmt(fmt_str).is_line_format())
                 return false;
-            _ofs << msg << std::flush;
-            return _ofs.good();
+            std::unique_lock<std::mutex> lock(_mutex);
+            _index_fmt = fmt_str;
+            return true;
         }
+        // 只在路径不合法时返回nullptr，max_size只在第一次创建时生效
         static RollFileSinkBySize::ptr get_sink(const std::string &path, long long max_size = DEFAULT_MAX_SIZE)
         {
             std::string absolute_path = Util::path_transform(path);
-            if (absolute_path == "")
+            if (absolute_path == "" || Util::get_fname(absolute_path) == "")
                 return RollFileSinkBySize::ptr(nullptr);
-            std::unique_lock<std::mutex> roll_filehash_lock(_roll_filehash_mutex);
-            if (_roll_filehash.find(absolute_path) != _roll_filehash.end())
-                return _roll_filehash[absolute_path];
-            RollFileSinkBySize::ptr tmp(new RollFileSinkBySize(absolute_path, max_size));
-            if (tmp->_state == false)
-                return RollFileSinkBySize::ptr(nullptr);
-            _roll_filehash[absolute_path] = tmp;
-            return _roll_filehash[absolute_path];
+            std::unique_lock<std::mutex> sinks_lock(_sinks_mutex);
+            FileSink::ptr &sink = _sinks["roll:" + absolute_path];
+            if (sink == nullptr)
+                sink.reset(new RollFileSinkBySize(absolute_path, max_size));
+            return std::static_pointer_cast<RollFileSinkBySize>(sink);
         }
 
     private:
         RollFileSinkBySize(const RollFileSinkBySize &tp) = delete;
         RollFileSinkBySize &operator=(const RollFileSinkBySize &tp) = delete;
-        RollFileSinkBySize(const std::string &path, long long max_size = DEFAULT_MAX_SIZE) : _max_size(max_size)
+        RollFileSinkBySize(const std::string &absolute_path, long long max_size = DEFAULT_MAX_SIZE) : _max_size(max_size)
         {
-            std::string absolute_path = Util::path_transform(path);
-            if (absolute_path == "")
-                _state = false;
-            // 判断文件所在路径是否存在，不存在就先创建
-            if (_state)
-            {
-                _fdir_path = Util::file_dir(absolute_path);
-                if (_fdir_path[_fdir_path.size() - 1] != '/')
-                    _fdir_path.push_back('/');
-                _state = Util::create_dir(_fdir_path);
-            }
-            if (_state)
-            {
-                _base_fname = Util::get_fname(absolute_path);
-                if (_base_fname == "")
-                    _state = false;
-            }
-            if (_state)
-            {
-                _cur_filename = get_filename_by_time();
-                _ofs.open(_cur_filename, std::ios::binary | std::ios::app);
-                _state = _ofs.is_open();
-            }
+            _path = absolute_path;
+            _fdir_path = Util::file_dir(absolute_path);
+            if (_fdir_path[_fdir_path.size() - 1] != '/')
+                _fdir_path.push_back('/');
+            _base_fname = Util::get_fname(absolute_path);
         }
         // 根据当前时间动态获取文件名,并修改_last_time
         std::string get_filename_by_time()
@@ -209,29 +545,814 @@ namespace log_system
             sstr << _base_fname;
             return sstr.str();
         }
-        // 获取文件的大小,返回-1表示失败
-        long long get_file_size()
-        {
-            struct stat att;
-            if (stat(_cur_filename.c_str(), &att) == -1)
-                return -1;
-            else
-                return att.st_size;
-        }
 
     protected:
         std::string _base_fname;   // 文件名（仅仅只含文件的名字，不含路径）
         std::string _fdir_path;    // 文件所处的目录的路径
         std::string _cur_filename; // 当前文件流所管理的完整文件名（加上了时间构造出来的完整文件名路径）
-        time_t _last_time;         // 记录_cur_filename创建时的时间戳
+        time_t _last_time = 0;     // 记录_cur_filename创建时的时间戳
         long long _max_size;       // 滚动文件的最大大小(以字节为单位)
+        std::string _index_fmt;    // 为写满的滚动文件建立索引时使用的格式化字符串，为空时不建立索引
+    };
+
+    // 按等级路由的落地类，其本身不输出日志，而是根据日志等级将日志转交给不同的子落地对象
+    // 例如将DEBUG~WARN的日志输出到普通文件，将ERROR及以上的日志输出到另一个每次写入都同步到磁盘的文件
+    // 该类没有落地位置，因此不做全局唯一性管理，每次调用get_sink()都会创建一个新的对象
+    class LevelRouteSink : public LogSink
+    {
+    public:
+        using ptr = std::shared_ptr<LevelRouteSink>;
+        // 一条路由规则，等级在[_min_level, _max_level]范围内的日志交给_sink输出
+        struct Route
+        {
+            Level::value _min_level;
+            Level::value _max_level;
+            LogSink::ptr _sink;
+        };
+        ~LevelRouteSink() {}
+        // 不带等级的日志按DEBUG等级进行路由
+        bool log(const std::string &msg) override { return log(msg, Level::value::DEBUG); }
+        bool log(const std::string &msg, Level::value val) override
+        {
+            bool ret = true;
+            for (auto &route : _routes)
+            {
+                if (val < route._min_level || val > route._max_level || !route._sink->should_log(val))
+                    continue;
+                ret &= route._sink->write_record(msg, val);
+            }
+            return ret;
+        }
+        std::string name() const override { return "route"; }
+        const std::vector<Route> &routes() const { return _routes; }
+        // 根据路由规则创建LevelRouteSink对象，规则中有空的子落地对象或等级范围不合法时返回nullptr
+        // 同一条日志可以同时命中多条规则，此时会被输出到每个命中的子落地对象中
+        static LevelRouteSink::ptr get_sink(const std::vector<Route> &routes)
+        {
+            for (auto &route : routes)
+            {
+                if (route._sink == nullptr || route._min_level > route._max_level)
+                    return LevelRouteSink::ptr(nullptr);
+            }
+            LevelRouteSink::ptr sink(new LevelRouteSink(routes));
+            Level::value min_level = Level::value::OFF;
+            for (auto &route : routes)
+                min_level = route._min_level < min_level ? route._min_level : min_level;
+            sink->set_level(min_level); // 没有任何规则能命中的日志在日志器中就被过滤掉
+            return sink;
+        }
+
+    private:
+        LevelRouteSink(const std::vector<Route> &routes) : _routes(routes) {}
+        LevelRouteSink(const LevelRouteSink &tp) = delete;
+        LevelRouteSink &operator=(const LevelRouteSink &tp) = delete;
+
+    private:
+        std::vector<Route> _routes; // 所有的路由规则，创建后不再修改，因此无需加锁
+    };
+
+    // 环形内存落地类，将日志保存在一块预先分配好的固定大小的内存环中，写满后新日志覆盖最旧的日志，不会产生任何磁盘IO
+    // 写入过程只使用原子操作，不加锁也不分配内存；dump()只使用open/write/close等异步信号安全的系统调用，
+    // 因此既可以由用户主动调用，也会在收到FATAL等级的日志时自动调用，还可以在SIGSEGV/SIGABRT等致命信号的处理函数中调用
+    // 每条日志占用环中的一个槽位，超出槽位大小的日志会被截断；dump与写入并发时，正在被改写的槽位会被跳过
+    class RingBufferSink : public LogSink
+    {
+#define DEFAULT_RING_SLOT_COUNT 4096 // 环形内存默认的槽位数量(即最多保存的日志条数)
+#define DEFAULT_RING_SLOT_SIZE 512   // 环形内存中每个槽位的默认大小(以字节为单位)
+#define MAX_CRASH_RING_SINKS 16      // 致命信号发生时最多能转储的RingBufferSink对象数量
+#define MAX_RING_SLOT_SIZE 4096      // 槽位大小的上限，转储时每个槽位要先完整复制到栈上再校验序号
+    public:
+        using ptr = std::shared_ptr<RingBufferSink>;
+        ~RingBufferSink() {}
+        bool log(const std::string &msg) override
+        {
+            if (msg.empty())
+                return false;
+            uint64_t idx = _write_idx.fetch_add(1, std::memory_order_relaxed);
+            Slot &slot = _slots[idx % _slot_count];
+            // 按顺序锁(seqlock)的方式写入：先将槽位标记为正在写入，写完内容后再发布新的序号，dump据此丢弃复制期间被改写的槽位
+            slot._seq.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            size_t len = msg.size() < _slot_size ? msg.size() : _slot_size;
+            char *dst = _data.get() + (idx % _slot_count) * _slot_size;
+            memcpy(dst, msg.data(), len);
+            if (len < msg.size())
+                dst[len - 1] = '\n'; // 被截断的日志仍以换行结尾，保证转储出来的文件逐行可读
+            slot._len.store(len, std::memory_order_relaxed);
+            slot._seq.store(idx + 1, std::memory_order_release);
+            return true;
+        }
+        // 收到FATAL及以上等级的日志时，写入后立即将环中的内容转储到文件
+        bool log(const std::string &msg, Level::value val) override
+        {
+            bool ret = log(msg);
+            if (val >= Level::value::FATAL)
+                ret &= dump();
+            return ret;
+        }
+        std::string name() const override { return "ring:" + _dump_path; }
+        // 将环中现存的日志按从旧到新的顺序追加写入转储文件，只使用异步信号安全的调用，成功返回true
+        // 每个槽位先复制到栈上的缓冲区，复制前后各读一次序号，两次不一致(复制期间被并发写入的日志改写)的槽位会被跳过，不会输出写了一半的内容
+        bool dump()
+        {
+            int fd = open(_dump_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd == -1)
+                return false;
+            static const char head[] = "---------- ring buffer dump ----------\n";
+            bool ret = Util::write_all(fd, head, sizeof(head) - 1);
+            char buf[MAX_RING_SLOT_SIZE];
+            uint64_t end = _write_idx.load(std::memory_order_acquire);
+            uint64_t begin = end > _slot_count ? end - _slot_count : 0;
+            for (uint64_t idx = begin; idx < end && ret; idx++)
+            {
+                Slot &slot = _slots[idx % _slot_count];
+                if (slot._seq.load(std::memory_order_acquire) != idx + 1)
+                    continue;
+                size_t len = slot._len.load(std::memory_order_relaxed);
+                len = len < _slot_size ? len : _slot_size;
+                memcpy(buf, _data.get() + (idx % _slot_count) * _slot_size, len);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot._seq.load(std::memory_order_relaxed) != idx + 1)
+                    continue;
+                ret = Util::write_all(fd, buf, len);
+            }
+            close(fd);
+            return ret;
+        }
+        // 转储所有已创建的RingBufferSink对象，可在致命信号处理函数中调用
+        static void dump_all()
+        {
+            size_t count = _crash_sink_count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count && i < MAX_CRASH_RING_SINKS; i++)
+                _crash_sinks[i]->dump();
+        }
+        // 为SIGSEGV/SIGABRT/SIGBUS/SIGFPE注册信号处理函数，进程因这些信号崩溃时先转储所有环形内存再按默认方式终止
+        static bool install_crash_handler()
+        {
+            struct sigaction act;
+            memset(&act, 0, sizeof(act));
+            act.sa_handler = crash_handler;
+            act.sa_flags = SA_RESETHAND; // 处理函数执行一次后恢复默认处理方式，再次触发信号即可让进程按默认方式终止
+            sigemptyset(&act.sa_mask);
+            const int sigs[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE};
+            for (int sig : sigs)
+            {
+                if (sigaction(sig, &act, nullptr) == -1)
+                    return false;
+            }
+            return true;
+        }
+        // 已经为absolute_path创建过RingBufferSink对象时返回true
+        static bool exists(const std::string &absolute_path)
+        {
+            std::unique_lock<std::mutex> ringhash_lock(_ringhash_mutex);
+            return _ringhash.find(absolute_path) != _ringhash.end();
+        }
+        // 还能创建的RingBufferSink对象的数量
+        static size_t available() { return MAX_CRASH_RING_SINKS - _crash_sink_count.load(std::memory_order_acquire); }
+        // 根据转储文件路径获取RingBufferSink对象，同一转储路径全局只有一个对象，slot_count和slot_size只在第一次创建时生效
+        // slot_size不能超过MAX_RING_SLOT_SIZE
+        static RingBufferSink::ptr get_sink(const std::string &dump_path, size_t slot_count = DEFAULT_RING_SLOT_COUNT,
+                                            size_t slot_size = DEFAULT_RING_SLOT_SIZE)
+        {
+            std::string absolute_path = Util::path_transform(dump_path);
+            if (absolute_path == "" || slot_count == 0 || slot_size == 0 || slot_size > MAX_RING_SLOT_SIZE)
+                return RingBufferSink::ptr(nullptr);
+            std::unique_lock<std::mutex> ringhash_lock(_ringhash_mutex);
+            if (_ringhash.find(absolute_path) != _ringhash.end())
+                return _ringhash[absolute_path];
+            if (_crash_sink_count.load(std::memory_order_relaxed) >= MAX_CRASH_RING_SINKS)
+                return RingBufferSink::ptr(nullptr);
+            if (!Util::create_dir(Util::file_dir(absolute_path)))
+                return RingBufferSink::ptr(nullptr);
+            RingBufferSink::ptr tmp(new RingBufferSink(absolute_path, slot_count, slot_size));
+            _ringhash[absolute_path] = tmp;
+            size_t count = _crash_sink_count.load(std::memory_order_relaxed);
+            _crash_sinks[count] = tmp.get();
+            _crash_sink_count.store(count + 1, std::memory_order_release);
+            return tmp;
+        }
+
+    private:
+        // 环中每个槽位的状态，_seq为写入该槽位的日志序号加1，为0表示槽位为空或正在被写入
+        struct Slot
+        {
+            std::atomic<uint64_t> _seq{0};
+            std::atomic<size_t> _len{0};
+        };
+        RingBufferSink(const std::string &dump_path, size_t slot_count, size_t slot_size)
+            : _dump_path(dump_path), _slot_count(slot_count), _slot_size(slot_size),
+              _slots(new Slot[slot_count]), _data(new char[slot_count * slot_size]), _write_idx(0) {}
+        RingBufferSink(const RingBufferSink &tp) = delete;
+        RingBufferSink &operator=(const RingBufferSink &tp) = delete;
+        static void crash_handler(int sig)
+        {
+            int saved_errno = errno;
+            dump_all();
+            errno = saved_errno;
+            raise(sig);
+        }
+
+    private:
+        std::string _dump_path;           // 转储文件的绝对路径
+        size_t _slot_count;               // 槽位数量
+        size_t _slot_size;                // 每个槽位的大小
+        std::unique_ptr<Slot[]> _slots;   // 所有槽位的状态数组
+        std::unique_ptr<char[]> _data;    // 预先分配好的存放日志内容的内存，大小为_slot_count*_slot_size
+        std::atomic<uint64_t> _write_idx; // 下一条日志的序号
+
+        static std::unordered_map<std::string, RingBufferSink::ptr> _ringhash; // 全局范围内的所有RingBufferSink对象交给_ringhash统一管理，以转储路径作为唯一标识
+        static std::mutex _ringhash_mutex;                                     // 保证多线程操作_ringhash时的线程安全
+        static RingBufferSink *_crash_sinks[MAX_CRASH_RING_SINKS];             // 供信号处理函数使用的定长数组，信号处理函数中不能访问_ringhash
+        static std::atomic<size_t> _crash_sink_count;                          // _crash_sinks中有效对象的数量
+    };
+    std::unordered_map<std::string, RingBufferSink::ptr> RingBufferSink::_ringhash;
+    std::mutex RingBufferSink::_ringhash_mutex;
+    RingBufferSink *RingBufferSink::_crash_sinks[MAX_CRASH_RING_SINKS];
+    std::atomic<size_t> RingBufferSink::_crash_sink_count(0);
+
+    // 套接字落地类，将日志发送给本地或远程的日志收集程序，支持Unix域流式套接字、Unix域数据报套接字和TCP
+    // 日志先攒在待发送缓冲区中，攒够一批、遇到WARN及以上的日志、距上次发送超过SOCKET_BATCH_INTERVAL_MS或调用flush()时才合并为大块写入
+    // 套接字全程为非阻塞模式：连接断开或尚未建立时不会阻塞调用者(如异步工作线程)，而是按指数退避的间隔在后续的log()中重新发起连接，
+    // 期间的日志保留在待发送缓冲区中，缓冲区超出spill_size后新日志被丢弃并计入dropped()
+    // 流式套接字断线时，已发送了一部分的那条日志的剩余部分会被丢弃，重连后总是从一条完整的日志开始发送；数据报套接字的每个数据报只包含完整的日志
+    // 地址格式：Unix域套接字为套接字文件的路径，TCP为"主机:端口"
+    enum SocketType
+    {
+        SOCKET_UNIX_STREAM = 0,
+        SOCKET_UNIX_DGRAM,
+        SOCKET_TCP
+    };
+    class SocketSink : public LogSink
+    {
+#define DEFAULT_SOCKET_BATCH_SIZE (16 * 1024)       // 默认攒够多少字节的日志才发送一次，为0时每条日志都立即发送
+#define DEFAULT_SOCKET_SPILL_SIZE (4 * 1024 * 1024) // 待发送缓冲区默认的最大大小，断线期间最多缓存这么多字节的日志
+#define SOCKET_BATCH_INTERVAL_MS 100                // 待发送缓冲区中的日志最长的滞留时间(在下一条日志到来时检查)
+#define SOCKET_DGRAM_MAX_SIZE (60 * 1024)           // 每个数据报的最大大小
+#define SOCKET_RECONNECT_MIN_MS 100                 // 重连的最小退避间隔
+#define SOCKET_RECONNECT_MAX_MS 5000                // 重连的最大退避间隔
+#define SOCKET_FLUSH_TIMEOUT_MS 1000                // flush()等待套接字可写的最长时间
+    public:
+        using ptr = std::shared_ptr<SocketSink>;
+        ~SocketSink()
+        {
+            flush();
+            close_socket();
+        }
+        bool log(const std::string &msg) override { return log(msg, Level::value::OFF); }
+        bool log(const std::string &msg, Level::value val) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_pending.size() + msg.size() > _spill_size)
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            _pending += msg;
+            _record_ends.push_back(_pending.size());
+            auto now = std::chrono::steady_clock::now();
+            if (_pending.size() - _offset < _batch_size && (val < Level::value::WARN || val == Level::value::OFF) &&
+                now - _last_send < std::chrono::milliseconds(SOCKET_BATCH_INTERVAL_MS))
+                return true;
+            _last_send = now;
+            // 断线或对端暂时不可写时日志仍保留在缓冲区中，不视为失败
+            if (ensure_connected(now))
+                send_pending();
+            return true;
+        }
+        // 在SOCKET_FLUSH_TIMEOUT_MS内尽量将待发送缓冲区中的日志全部发送出去，全部发送成功返回true
+        bool flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SOCKET_FLUSH_TIMEOUT_MS);
+            while (_offset < _pending.size())
+            {
+                auto now = std::chrono::steady_clock::now();
+                if (now >= deadline || !ensure_connected(now))
+                    break;
+                if (!send_pending() && _fd != -1)
+                {
+                    struct pollfd pfd = {_fd, POLLOUT, 0};
+                    int timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+                    poll(&pfd, 1, timeout > 0 ? timeout : 0);
+                }
+            }
+            _last_send = std::chrono::steady_clock::now();
+            return _offset == _pending.size();
+        }
+        // 因待发送缓冲区已满或单条日志超出数据报大小而被丢弃的日志条数
+        uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+        // 当前是否已与对端建立连接
+        bool connected()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _fd != -1 && !_connecting;
+        }
+        std::string name() const override { return "socket:" + _key; }
+        // 获取发送到address的SocketSink对象，地址不合法时返回nullptr
+        // 创建时若对端尚未启动也能获取成功，之后会自动重连；batch_size和spill_size只在第一次创建时生效
+        static SocketSink::ptr get_sink(SocketType type, const std::string &address, size_t batch_size = DEFAULT_SOCKET_BATCH_SIZE,
+                                        size_t spill_size = DEFAULT_SOCKET_SPILL_SIZE)
+        {
+            std::string key;
+            switch (type)
+            {
+            case SOCKET_UNIX_STREAM:
+                key = "unix:" + address;
+                break;
+            case SOCKET_UNIX_DGRAM:
+                key = "unixgram:" + address;
+                break;
+            case SOCKET_TCP:
+                key = "tcp:" + address;
+                break;
+            default:
+                return SocketSink::ptr(nullptr);
+            }
+            std::unique_lock<std::mutex> sockethash_lock(_sockethash_mutex);
+            if (_sockethash.find(key) != _sockethash.end())
+                return _sockethash[key];
+            SocketSink::ptr tmp(new SocketSink(type, address, key, batch_size, spill_size));
+            if (tmp->_state == false)
+                return SocketSink::ptr(nullptr);
+            _sockethash[key] = tmp;
+            return _sockethash[key];
+        }
+        // 将type类型的对端地址解析为套接字地址，地址不合法或无法解析时返回false，可用于在创建落地对象之前检查地址
+        static bool resolve(SocketType type, const std::string &address, struct sockaddr_storage &addr, socklen_t &addr_len)
+        {
+            memset(&addr, 0, sizeof(addr));
+            if (type == SOCKET_TCP)
+                return resolve_tcp(address, addr, addr_len);
+            struct sockaddr_un *un = (struct sockaddr_un *)&addr;
+            if (address.empty() || address.size() >= sizeof(un->sun_path))
+                return false;
+            un->sun_family = AF_UNIX;
+            memcpy(un->sun_path, address.c_str(), address.size() + 1);
+            addr_len = sizeof(struct sockaddr_un);
+            return true;
+        }
 
     private:
-        static std::unordered_map<std::string, RollFileSinkBySize::ptr> _roll_filehash; // 全局范围内的所有RollFileSinkBySize对象交给_roll_filehash统一管理，以保证RollFileSinkBySize对象全局范围内的唯一性
-        static std::mutex _roll_filehash_mutex;                                         // 保证多线程操作_roll_filehash时的线程安全
+        SocketSink(SocketType type, const std::string &address, const std::string &key, size_t batch_size, size_t spill_size)
+            : _type(type), _key(key), _batch_size(batch_size), _spill_size(spill_size),
+              _last_send(std::chrono::steady_clock::now()), _next_retry(_last_send)
+        {
+            _state = resolve(type, address, _addr, _addr_len);
+            if (_state)
+                _pending.reserve(batch_size < spill_size ? batch_size : spill_size);
+        }
+        SocketSink(const SocketSink &tp) = delete;
+        SocketSink &operator=(const SocketSink &tp) = delete;
+        // 解析"主机:端口"形式的TCP地址，只在创建时解析一次
+        static bool resolve_tcp(const std::string &address, struct sockaddr_storage &addr, socklen_t &addr_len)
+        {
+            size_t pos = address.rfind(':');
+            if (pos == std::string::npos || pos == 0 || pos + 1 == address.size())
+                return false;
+            std::string host = address.substr(0, pos), port = address.substr(pos + 1);
+            if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+                host = host.substr(1, host.size() - 2);
+            struct addrinfo hints, *res = nullptr;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_NUMERICSERV;
+            if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || res == nullptr)
+                return false;
+            memcpy(&addr, res->ai_addr, res->ai_addrlen);
+            addr_len = res->ai_addrlen;
+            freeaddrinfo(res);
+            return true;
+        }
+        // 确保套接字已连接，未连接且到了重连时间就发起非阻塞连接，调用前需加锁
+        // 已连接返回true，连接尚未完成或失败返回false
+        bool ensure_connected(std::chrono::steady_clock::time_point now)
+        {
+            if (_fd != -1 && !_connecting)
+                return true;
+            if (_fd == -1)
+            {
+                if (now < _next_retry)
+                    return false;
+                int sock_type = (_type == SOCKET_UNIX_DGRAM ? SOCK_DGRAM : SOCK_STREAM) | SOCK_NONBLOCK | SOCK_CLOEXEC;
+                _fd = socket(_addr.ss_family, sock_type, 0);
+                if (_fd == -1)
+                    return connect_failed(now);
+                if (connect(_fd, (struct sockaddr *)&_addr, _addr_len) == 0)
+                    return connect_succeeded();
+                if (errno != EINPROGRESS && errno != EAGAIN)
+                    return connect_failed(now);
+                _connecting = true;
+            }
+            // 非阻塞连接正在进行中，检查是否已经完成
+            struct pollfd pfd = {_fd, POLLOUT, 0};
+            if (poll(&pfd, 1, 0) <= 0)
+                return false;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0)
+                return connect_failed(now);
+            return connect_succeeded();
+        }
+        bool connect_succeeded()
+        {
+            _connecting = false;
+            _backoff_ms = SOCKET_RECONNECT_MIN_MS;
+            return true;
+        }
+        bool connect_failed(std::chrono::steady_clock::time_point now)
+        {
+            close_socket();
+            _next_retry = now + std::chrono::milliseconds(_backoff_ms);
+            _backoff_ms = _backoff_ms * 2 > SOCKET_RECONNECT_MAX_MS ? SOCKET_RECONNECT_MAX_MS : _backoff_ms * 2;
+            return false;
+        }
+        void close_socket()
+        {
+            if (_fd != -1)
+                close(_fd);
+            _fd = -1;
+            _connecting = false;
+        }
+        // 以非阻塞方式尽量多地发送待发送缓冲区中的日志，调用前需加锁且套接字已连接
+        // 全部发送完毕返回true，对端暂时不可写或连接断开返回false
+        bool send_pending()
+        {
+            bool ret = true;
+            while (_offset < _pending.size())
+            {
+                size_t len = _pending.size() - _offset;
+                size_t first = 0;
+                if (_type == SOCKET_UNIX_DGRAM)
+                {
+                    // 数据报按日志边界切分，每个数据报只包含完整的日志
+                    while (_record_ends[first] <= _offset)
+                        first++;
+                    size_t last = first;
+                    while (last + 1 < _record_ends.size() && _record_ends[last + 1] - _offset <= SOCKET_DGRAM_MAX_SIZE)
+                        last++;
+                    len = _record_ends[last] - _offset;
+                }
+                ssize_t n = send(_fd, _pending.data() + _offset, len, MSG_NOSIGNAL);
+                if (n >= 0)
+                {
+                    _offset += n;
+                    continue;
+                }
+                if (errno == EINTR)
+                    continue;
+                ret = false;
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                    break;
+                if (_type == SOCKET_UNIX_DGRAM && errno == EMSGSIZE)
+                {
+                    // 单条日志超出了数据报的大小限制，只能丢弃
+                    _offset = _record_ends[first];
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                // 连接已断开，丢弃发送了一部分的日志的剩余部分，之后重新连接
+                skip_partial_record();
+                connect_failed(std::chrono::steady_clock::now());
+                break;
+            }
+            compact();
+            return ret;
+        }
+        // 若_offset位于某条日志的中间，就将其移动到下一条完整日志的起始位置
+        void skip_partial_record()
+        {
+            if (_offset == 0)
+                return;
+            for (size_t end : _record_ends)
+            {
+                if (end < _offset)
+                    continue;
+                if (end > _offset)
+                {
+                    _offset = end;
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+                break;
+            }
+        }
+        // 移除待发送缓冲区中已经发送完毕的日志
+        void compact()
+        {
+            if (_offset == 0)
+                return;
+            if (_offset == _pending.size())
+            {
+                _pending.clear();
+                _record_ends.clear();
+                _offset = 0;
+                return;
+            }
+            _pending.erase(0, _offset);
+            size_t i = 0;
+            while (i < _record_ends.size() && _record_ends[i] <= _offset)
+                i++;
+            _record_ends.erase(_record_ends.begin(), _record_ends.begin() + i);
+            for (auto &end : _record_ends)
+                end -= _offset;
+            _offset = 0;
+        }
+
+    private:
+        SocketType _type;                                  // 套接字类型
+        std::string _key;                                  // 全局唯一标识，由套接字类型和地址组成
+        struct sockaddr_storage _addr;                     // 对端地址
+        socklen_t _addr_len = 0;                           // 对端地址的长度
+        size_t _batch_size;                                // 攒够多少字节的日志才发送一次
+        size_t _spill_size;                                // 待发送缓冲区的最大大小
+        bool _state = true;                                // 状态标志位，地址不合法时为false
+        std::mutex _mutex;                                 // 互斥锁，保护以下成员的线程安全
+        int _fd = -1;                                      // 套接字的文件描述符，未连接时为-1
+        bool _connecting = false;                          // 非阻塞连接是否正在进行中
+        std::string _pending;                              // 待发送缓冲区
+        std::vector<size_t> _record_ends;                  // 待发送缓冲区中每条日志的结束位置
+        size_t _offset = 0;                                // 待发送缓冲区中已发送的字节数
+        std::chrono::steady_clock::time_point _last_send;  // 上一次发送的时间
+        std::chrono::steady_clock::time_point _next_retry; // 下一次允许重连的时间
+        long _backoff_ms = SOCKET_RECONNECT_MIN_MS;        // 当前的重连退避间隔
+        std::atomic<uint64_t> _dropped{0};                 // 被丢弃的日志条数
+
+        static std::unordered_map<std::string, SocketSink::ptr> _sockethash; // 全局范围内的所有SocketSink对象交给_sockethash统一管理，以套接字类型和地址作为唯一标识
+        static std::mutex _sockethash_mutex;                                 // 保证多线程操作_sockethash时的线程安全
+    };
+    std::unordered_map<std::string, SocketSink::ptr> SocketSink::_sockethash;
+    std::mutex SocketSink::_sockethash_mutex;
+
+    // 系统日志落地类，不经过syslog(3)及其全局锁，直接按RFC 5424格式将日志以数据报的形式发送到系统日志守护进程监听的Unix域套接字(默认/dev/log)
+    // 每条日志对应一个数据报，日志等级映射为syslog的严重程度；多条日志先攒在批次中，再通过sendmmsg()一次系统调用发送
+    // 套接字为非阻塞模式，不会阻塞调用者：守护进程来不及接收(EAGAIN)时未发送的日志留在批次中等下次发送，批次已满时新日志被丢弃；
+    // 守护进程未运行时直接丢弃该批日志；被丢弃的日志都计入dropped()
+    // 每个套接字路径全局只有一个对象，应用名称、facility和批次大小只在第一次创建时生效
+    class SyslogSink : public LogSink
+    {
+#define DEFAULT_SYSLOG_PATH "/dev/log" // 系统日志守护进程默认监听的套接字路径
+#define DEFAULT_SYSLOG_FACILITY 1      // 默认的facility(user-level messages)
+#define DEFAULT_SYSLOG_BATCH 16        // 默认攒够多少条日志才发送一次，为1时每条日志都立即发送
+#define SYSLOG_BATCH_INTERVAL_MS 100   // 批次中的日志最长的滞留时间(在下一条日志到来时检查)
+#define SYSLOG_RECONNECT_MS 1000       // 连接守护进程失败后重新连接的间隔
+#define SYSLOG_RECORD_RESERVE 512      // 批次中每条日志预先分配的空间大小
+#define SYSLOG_APP_NAME_MAX 48         // RFC 5424中APP-NAME的最大长度
+#define SYSLOG_HOSTNAME_MAX 255        // RFC 5424中HOSTNAME的最大长度
+    public:
+        using ptr = std::shared_ptr<SyslogSink>;
+        ~SyslogSink()
+        {
+            flush();
+            if (_fd != -1)
+                close(_fd);
+        }
+        bool log(const std::string &msg) override { return log(msg, Level::value::OFF); }
+        bool log(const std::string &msg, Level::value val) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto now = std::chrono::steady_clock::now();
+            // 批次被之前来不及发送的日志占满时先尝试发送，仍然发送不了就丢弃这条新日志
+            if (_batch_count == _batch.size() && !send_batch(now) && _batch_count == _batch.size())
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            std::string &record = _batch[_batch_count++];
+            record.clear();
+            append_header(record, val);
+            record.append(msg, 0, !msg.empty() && msg.back() == '\n' ? msg.size() - 1 : msg.size());
+            if (_batch_count < _batch.size() && val < Level::value::WARN &&
+                now - _last_send < std::chrono::milliseconds(SYSLOG_BATCH_INTERVAL_MS))
+                return true;
+            return send_batch(now);
+        }
+        bool flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return send_batch(std::chrono::steady_clock::now());
+        }
+        // 因守护进程来不及接收或未运行而被丢弃的日志条数
+        uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+        std::string name() const override { return "syslog:" + _path; }
+        // 获取向path发送日志的SyslogSink对象，app_name为空时使用当前程序名，路径过长时返回nullptr
+        // 创建时守护进程未运行也能获取成功，之后会定期重新连接
+        static SyslogSink::ptr get_sink(const std::string &app_name = "", int facility = DEFAULT_SYSLOG_FACILITY,
+                                        const std::string &path = DEFAULT_SYSLOG_PATH, size_t batch = DEFAULT_SYSLOG_BATCH)
+        {
+            if (path.empty() || path.size() >= sizeof(((struct sockaddr_un *)nullptr)->sun_path) || facility < 0 || facility > 23)
+                return SyslogSink::ptr(nullptr);
+            std::unique_lock<std::mutex> sysloghash_lock(_sysloghash_mutex);
+            if (_sysloghash.find(path) != _sysloghash.end())
+                return _sysloghash[path];
+            SyslogSink::ptr tmp(new SyslogSink(app_name, facility, path, batch == 0 ? 1 : batch));
+            _sysloghash[path] = tmp;
+            return _sysloghash[path];
+        }
+        // 将日志等级映射为syslog的严重程度，不带等级的日志视为notice
+        static int severity(Level::value val)
+        {
+            switch (val)
+            {
+            case Level::value::DEBUG:
+                return 7;
+            case Level::value::INFO:
+                return 6;
+            case Level::value::WARN:
+                return 4;
+            case Level::value::ERROR:
+                return 3;
+            case Level::value::FATAL:
+                return 2;
+            default:
+                return 5;
+            }
+        }
+
+    private:
+        SyslogSink(const std::string &app_name, int facility, const std::string &path, size_t batch)
+            : _path(path), _facility(facility), _batch(batch), _mmsgs(batch), _iovs(batch),
+              _last_send(std::chrono::steady_clock::now()), _next_retry(_last_send)
+        {
+            char host[256] = {0};
+            if (gethostname(host, sizeof(host) - 1) == 0 && host[0] != '\0')
+                _hostname = host;
+            _app_name = app_name.empty() ? program_invocation_short_name : app_name;
+            // 两个字段都只能由可打印的ASCII字符组成，且有长度限制
+            _hostname = _hostname.substr(0, SYSLOG_HOSTNAME_MAX);
+            _app_name = _app_name.substr(0, SYSLOG_APP_NAME_MAX);
+            for (auto &field : {&_hostname, &_app_name})
+            {
+                if (field->empty())
+                    *field = "-";
+                for (auto &c : *field)
+                    c = (c > 32 && c < 127) ? c : '_';
+            }
+            _pid = current_pid(); // 同时在fork之前完成pthread_atfork()的注册
+            _pid_str = std::to_string(_pid);
+            for (auto &record : _batch)
+                record.reserve(SYSLOG_RECORD_RESERVE);
+            memset(&_addr, 0, sizeof(_addr));
+            _addr.sun_family = AF_UNIX;
+            memcpy(_addr.sun_path, path.c_str(), path.size() + 1);
+        }
+        SyslogSink(const SyslogSink &tp) = delete;
+        SyslogSink &operator=(const SyslogSink &tp) = delete;
+        // 当前进程的ID，通过pthread_atfork()在fork后的子进程中更新缓存，避免每条日志都调用getpid()
+        static pid_t current_pid()
+        {
+            static std::atomic<pid_t> pid(getpid());
+            static int registered = pthread_atfork(nullptr, nullptr, []()
+                                                   { pid.store(getpid(), std::memory_order_relaxed); });
+            (void)registered;
+            return pid.load(std::memory_order_relaxed);
+        }
+        // 追加RFC 5424的消息头：<PRI>1 时间戳 主机名 应用名 进程ID MSGID 结构化数据
+        // fork出的子进程继续使用该对象时，进程ID换成子进程的
+        void append_header(std::string &out, Level::value val)
+        {
+            pid_t pid = current_pid();
+            if (pid != _pid)
+            {
+                _pid = pid;
+                _pid_str = std::to_string(pid);
+            }
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            if (ts.tv_sec != _header_sec)
+            {
+                struct tm t;
+                localtime_r(&ts.tv_sec, &t);
+                _time_len = strftime(_time_str, sizeof(_time_str), "%Y-%m-%dT%H:%M:%S", &t);
+                // 时区偏移限制在RFC 5424允许的[-23:59, +23:59]内
+                int off = (int)(t.tm_gmtoff / 60);
+                int abs_off = off < 0 ? -off : off;
+                abs_off = abs_off < 24 * 60 ? abs_off : 24 * 60 - 1;
+                if (off == 0)
+                    snprintf(_tz_str, sizeof(_tz_str), "Z");
+                else
+                    snprintf(_tz_str, sizeof(_tz_str), "%c%02d:%02d", off < 0 ? '-' : '+', abs_off / 60, abs_off % 60);
+                _header_sec = ts.tv_sec;
+            }
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "<%d>1 ", _facility * 8 + severity(val));
+            out.append(buf, n);
+            out.append(_time_str, _time_len);
+            n = snprintf(buf, sizeof(buf), ".%06ld", ts.tv_nsec / 1000);
+            out.append(buf, n);
+            out += _tz_str;
+            out += ' ';
+            out += _hostname;
+            out += ' ';
+            out += _app_name;
+            out += ' ';
+            out += _pid_str;
+            out += " - - ";
+        }
+        // 连接守护进程的套接字，调用前需加锁，已连接返回true
+        bool ensure_connected(std::chrono::steady_clock::time_point now)
+        {
+            if (_fd != -1)
+                return true;
+            if (now < _next_retry)
+                return false;
+            _next_retry = now + std::chrono::milliseconds(SYSLOG_RECONNECT_MS);
+            _fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (_fd == -1)
+                return false;
+            if (connect(_fd, (struct sockaddr *)&_addr, sizeof(_addr)) == -1)
+            {
+                close(_fd);
+                _fd = -1;
+                return false;
+            }
+            return true;
+        }
+        // 通过sendmmsg()发送批次中的所有日志，调用前需加锁，全部发送成功返回true
+        // 守护进程来不及接收时未发送的日志移到批次开头留待下次发送，其他原因发送不了的日志被丢弃
+        bool send_batch(std::chrono::steady_clock::time_point now)
+        {
+            _last_send = now;
+            if (_batch_count == 0)
+                return true;
+            size_t sent = 0, dropped = 0; // sent为已经处理(发送或丢弃)的日志条数
+            bool keep = false;            // 是否保留未发送的日志
+            if (ensure_connected(now))
+            {
+                for (size_t i = 0; i < _batch_count; i++)
+                {
+                    _iovs[i].iov_base = (void *)_batch[i].data();
+                    _iovs[i].iov_len = _batch[i].size();
+                    memset(&_mmsgs[i], 0, sizeof(_mmsgs[i]));
+                    _mmsgs[i].msg_hdr.msg_iov = &_iovs[i];
+                    _mmsgs[i].msg_hdr.msg_iovlen = 1;
+                }
+                while (sent < _batch_count)
+                {
+                    int n = sendmmsg(_fd, &_mmsgs[sent], _batch_count - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+                    if (n > 0)
+                    {
+                        sent += n;
+                        continue;
+                    }
+                    if (n == -1 && errno == EINTR)
+                        continue;
+                    if (n == -1 && errno == EMSGSIZE) // 单条日志超出了数据报的大小限制，只能丢弃
+                    {
+                        sent++, dropped++;
+                        continue;
+                    }
+                    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS))
+                        keep = true;
+                    else
+                    {
+                        // 守护进程重启后原来的套接字失效，下次发送前重新连接
+                        close(_fd);
+                        _fd = -1;
+                    }
+                    break;
+                }
+            }
+            if (!keep)
+            {
+                dropped += _batch_count - sent;
+                sent = _batch_count;
+            }
+            if (dropped > 0)
+                _dropped.fetch_add(dropped, std::memory_order_relaxed);
+            for (size_t i = sent; i < _batch_count; i++) // 交换而不是拷贝，保留各元素已分配的空间
+                _batch[i - sent].swap(_batch[i]);
+            _batch_count -= sent;
+            return dropped == 0 && _batch_count == 0;
+        }
+
+    private:
+        std::string _path;                                 // 守护进程监听的套接字路径
+        int _facility;                                     // syslog的facility
+        std::string _hostname = "-";                       // 主机名
+        std::string _app_name;                             // 应用名称
+        pid_t _pid = 0;                                    // 进程ID
+        std::string _pid_str;                              // 进程ID的字符串形式
+        struct sockaddr_un _addr;                          // 守护进程的套接字地址
+        std::mutex _mutex;                                 // 互斥锁，保护以下成员的线程安全
+        int _fd = -1;                                      // 套接字的文件描述符，未连接时为-1
+        std::vector<std::string> _batch;                   // 批次中已按RFC 5424格式组装好的日志，元素被复用以避免内存分配
+        size_t _batch_count = 0;                           // 批次中日志的条数
+        std::vector<struct mmsghdr> _mmsgs;                // sendmmsg()使用的消息数组
+        std::vector<struct iovec> _iovs;                   // sendmmsg()使用的数据块数组
+        std::chrono::steady_clock::time_point _last_send;  // 上一次发送的时间
+        std::chrono::steady_clock::time_point _next_retry; // 下一次允许重新连接的时间
+        time_t _header_sec = -1;                           // _time_str和_tz_str对应的秒
+        char _time_str[32];                                // 缓存的时间戳(精确到秒)
+        size_t _time_len = 0;                              // _time_str的长度
+        char _tz_str[8];                                   // 缓存的时区偏移
+        std::atomic<uint64_t> _dropped{0};                 // 被丢弃的日志条数
+
+        static std::unordered_map<std::string, SyslogSink::ptr> _sysloghash; // 全局范围内的所有SyslogSink对象交给_sysloghash统一管理，以套接字路径作为唯一标识
+        static std::mutex _sysloghash_mutex;                                 // 保证多线程操作_sysloghash时的线程安全
     };
-    std::unordered_map<std::string, RollFileSinkBySize::ptr> RollFileSinkBySize::_roll_filehash;
-    std::mutex RollFileSinkBySize::_roll_filehash_mutex;
+    std::unordered_map<std::string, SyslogSink::ptr> SyslogSink::_sysloghash;
+    std::mutex SyslogSink::_sysloghash_mutex;
 
     // ...支持在此处扩展，可以根据使用需求自行实现更多的落地方向子类使得日志可以向更多的位置输出
 }
@@ -0,0 +1,29 @@
+#ifndef LOG_SYSTEM_TEST_H
+#define LOG_SYSTEM_TEST_H
+
+// 测试程序的公共工具，每个test_*.cc都是独立的测试程序，通过make test编译并依次运行，全部通过时返回0
+#include "log.h"
+
+#define TEST_DIR "./data/test/" // 测试过程中产生的文件所在目录
+
+static int g_test_failures = 0; // 当前测试程序中失败的检查数量
+
+// 检查条件是否成立，不成立时输出所在位置并记录失败，不中断测试
+#define CHECK(cond)                                                                   \
+    do                                                                                \
+    {                                                                                 \
+        if (!(cond))                                                                  \
+        {                                                                             \
+            fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            g_test_failures++;                                                        \
+        }                                                                             \
+    } while (0)
+
+// 输出测试结果并返回测试程序的退出码
+static int test_result(const char *name)
+{
+    printf("%-24s %s\n", name, g_test_failures == 0 ? "通过" : "失败");
+    return g_test_failures == 0 ? 0 : 1;
+}
+
+#endif
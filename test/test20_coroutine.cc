@@ -0,0 +1,106 @@
+// 检查以C++20编译时的协程接口：co_await LOG_DURABLE(...)在组提交之后才恢复，写入失败时结果为false，
+// 同一个完成通知可以同时被多个协程co_await并注册多个回调
+#include "test.h"
+#include <thread>
+#include <chrono>
+
+// 不需要返回值、立即开始执行的协程类型
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// 写入前等待闸门打开、记录同步次数的落地类，fail为true时写入总是失败
+class GateSink : public log_system::LogSink
+{
+public:
+    GateSink(bool fail) : _fail(fail) {}
+    bool log(const std::string &) override
+    {
+        while (!_open.load())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return !_fail;
+    }
+    bool flush() override
+    {
+        _flushes++;
+        return true;
+    }
+    bool _fail;
+    std::atomic<bool> _open{false};
+    std::atomic<size_t> _flushes{0};
+};
+
+std::atomic<int> g_resumed{0};
+std::atomic<int> g_ok{0};
+std::atomic<int> g_flushed_before_resume{0};
+
+Task audit(log_system::Logger::ptr logger, GateSink *sink)
+{
+    bool ok = co_await LOG_DURABLE(logger, log_system::Level::INFO, "audit");
+    g_ok += ok;
+    g_flushed_before_resume += sink->_flushes.load() > 0;
+    g_resumed++;
+}
+
+Task await_twice(log_system::LogCompletion::ptr completion)
+{
+    g_ok += co_await completion;
+    g_resumed++;
+}
+
+static bool wait_resumed(int count)
+{
+    for (int i = 0; i < 5000 && g_resumed.load() < count; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return g_resumed.load() == count;
+}
+
+int main()
+{
+    GateSink *good = new GateSink(false), *bad = new GateSink(true);
+    log_system::LogSink::ptr good_sink(good), bad_sink(bad);
+    CHECK(log_system::add_logger("coroutine_good", log_system::ASYNC_LOGGER, {good_sink}, log_system::Level::DEBUG, "%m%n"));
+    CHECK(log_system::add_logger("coroutine_bad", log_system::ASYNC_LOGGER, {bad_sink}, log_system::Level::DEBUG, "%m%n"));
+
+    // 闸门打开前协程都挂起在co_await处，组提交之后才恢复
+    for (int i = 0; i < 100; i++)
+        audit(log_system::get_logger("coroutine_good"), good);
+    CHECK(g_resumed.load() == 0);
+    good->_open = true;
+    CHECK(wait_resumed(100));
+    CHECK(g_ok.load() == 100);
+    CHECK(g_flushed_before_resume.load() == 100);
+
+    // 写入失败的日志co_await的结果为false
+    g_resumed = 0, g_ok = 0;
+    audit(log_system::get_logger("coroutine_bad"), bad);
+    CHECK(g_resumed.load() == 0);
+    bad->_open = true;
+    CHECK(wait_resumed(1));
+    CHECK(g_ok.load() == 0);
+
+    // 同一个完成通知上的多个协程和多个回调都会被通知
+    good->_open = false;
+    g_resumed = 0, g_ok = 0;
+    auto completion = LOG_DURABLE(log_system::get_logger("coroutine_good"), log_system::Level::INFO, "shared");
+    std::atomic<int> callbacks{0};
+    completion->on_complete([&](bool ok)
+                            { callbacks += ok; });
+    completion->on_complete([&](bool ok)
+                            { callbacks += ok; });
+    await_twice(completion);
+    await_twice(completion);
+    good->_open = true;
+    CHECK(wait_resumed(2));
+    CHECK(g_ok.load() == 2);
+    CHECK(callbacks.load() == 2);
+    return test_result("test20_coroutine");
+}
@@ -0,0 +1,56 @@
+// 检查稳定运行时(预热之后)同步/异步日志器输出每条日志时没有任何堆内存分配
+#include "test.h"
+#include <new>
+
+// 替换全局的operator new以统计内存分配次数，只在g_count_alloc为true时计数
+static std::atomic<bool> g_count_alloc(false);
+static std::atomic<size_t> g_alloc_count(0);
+void *operator new(size_t size)
+{
+    if (g_count_alloc.load(std::memory_order_relaxed))
+        g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+// 禁止内联，否则GCC会把内联后的free()与标准库中被识别为内建函数的operator new误判为不匹配(-Wmismatched-new-delete)
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { free(p); }
+
+// 日志器在预热之后输出count条日志产生的内存分配次数
+static size_t count_alloc(log_system::LoggerType type, const std::string &pattern, size_t count)
+{
+    static size_t id = 0;
+    std::string logger_name = "alloc_" + std::to_string(id++);
+    log_system::LogSink::ptr sink = log_system::get_sink<log_system::FileSink>(TEST_DIR "alloc_" + std::to_string(id) + ".log");
+    CHECK(log_system::add_logger(logger_name, type, {sink}, log_system::Level::DEBUG, pattern));
+    log_system::Logger::ptr logger = log_system::get_logger(logger_name);
+    std::string str(100, 'L');
+    for (size_t i = 0; i < 10000; i++) // 预热：让线程局部缓冲区、缓冲区元素等都分配好足够的空间
+        LOG_DEBUG(logger, "%s %zu", str.c_str(), i);
+    logger->flush();
+    g_alloc_count = 0;
+    g_count_alloc = true;
+    for (size_t i = 0; i < count; i++)
+        LOG_DEBUG(logger, "%s %zu", str.c_str(), i);
+    logger->flush();
+    g_count_alloc = false;
+    return g_alloc_count.load();
+}
+
+int main()
+{
+    log_system::LoggerType types[] = {log_system::SYNC_LOGGER, log_system::ASYNC_LOGGER};
+    for (auto type : types)
+    {
+        for (const char *pattern : {"%m%n", DEFAULT_FMT_STR})
+        {
+            size_t allocs = count_alloc(type, pattern, 20000);
+            if (allocs != 0)
+                fprintf(stderr, "%s %s: 内存分配次数 %zu\n", type == log_system::SYNC_LOGGER ? "sync" : "async", pattern, allocs);
+            CHECK(allocs == 0);
+        }
+    }
+    return test_result("test_alloc");
+}
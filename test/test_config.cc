@@ -0,0 +1,45 @@
+// 检查配置的重新加载：加载失败时已有的落地对象设置、线程池和日志器都保持不变，删除的level恢复为DEBUG，删除的日志器被移除
+#include "test.h"
+
+int main()
+{
+    std::string path = TEST_DIR "config_" + std::to_string(getpid()) + ".log";
+    std::string base = "[sink:file]\ntype = file\npath = " + path + "\n";
+    CHECK(log_system::Config::load_string(base + "level = WARN\n"
+                                          "[logger:config_a]\nsinks = file\n"
+                                          "[logger:config_b]\nsinks = file\n"));
+    auto file = log_system::FileSink::get_sink(path);
+    CHECK(file->get_level() == log_system::Level::WARN);
+    CHECK(log_system::get_logger("config_a") != nullptr && log_system::get_logger("config_b") != nullptr);
+
+    // 创建落地对象时才会失败的配置在修改任何设置之前就被拒绝
+    const char *bad[] = {"[sink:remote]\ntype = socket\nsocket_type = tcp\naddress = no-such-host.invalid:514\n",
+                         "[sink:ring]\ntype = ring\npath = /proc/no_such_dir/ring.log\n",
+                         "[sink:syslog]\ntype = syslog\npath = \n"};
+    for (auto extra : bad)
+    {
+        CHECK(!log_system::Config::load_string(base + "level = ERROR\n"
+                                               "[pool:config_pool]\nthreads = 1\n"
+                                               "[logger:config_c]\ntype = async\npool = config_pool\nsinks = file\n" +
+                                               extra));
+        CHECK(!log_system::Config::last_error().empty());
+        CHECK(file->get_level() == log_system::Level::WARN);
+        CHECK(log_system::AsynWorkerPool::get_pool("config_pool") == nullptr);
+        CHECK(log_system::get_logger("config_c") == nullptr);
+    }
+    std::string rings;
+    for (int i = 0; i <= MAX_CRASH_RING_SINKS; i++)
+        rings += "[sink:ring" + std::to_string(i) + "]\ntype = ring\npath = " TEST_DIR "config_ring" + std::to_string(i) + ".log\n";
+    CHECK(!log_system::Config::load_string(base + rings));
+    CHECK(!log_system::RingBufferSink::exists(log_system::Util::path_transform(TEST_DIR "config_ring0.log")));
+    CHECK(file->get_level() == log_system::Level::WARN);
+
+    // 删除level后恢复为DEBUG，删除的日志器被移除，手动添加的日志器不受影响
+    CHECK(log_system::add_logger("manual", log_system::SYNC_LOGGER, {file}));
+    CHECK(log_system::Config::load_string(base + "[logger:config_a]\nsinks = file\n"));
+    CHECK(file->get_level() == log_system::Level::DEBUG);
+    CHECK(log_system::get_logger("config_a") != nullptr);
+    CHECK(log_system::get_logger("config_b") == nullptr);
+    CHECK(log_system::get_logger("manual") != nullptr);
+    return test_result("test_config");
+}
@@ -0,0 +1,185 @@
+// 检查需要确认落地的日志(log_durable)：同一队列有多个工作线程时逐条等待不会卡住，多线程并发等待全部完成，
+// 线程池的flush()返回时要求同步的日志都已组提交，以及需要等待的落地对象数量与实际写入的一致
+#include "test.h"
+#include <thread>
+#include <future>
+#include <chrono>
+
+// 统计写入和同步次数的落地类，flush()较慢且与FileSink一样互斥执行，以模拟fsync()
+class SlowSyncSink : public log_system::LogSink
+{
+public:
+    bool log(const std::string &) override
+    {
+        _written++;
+        return true;
+    }
+    bool flush() override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        _flushes++;
+        return true;
+    }
+    std::mutex _mutex;
+    std::atomic<size_t> _written{0};
+    std::atomic<size_t> _flushes{0};
+};
+
+// 日志消息为"a"、"b"、"c"时阻塞到对应的闸门打开为止的落地类，用于控制每个工作线程处理到哪条日志
+class GateSink : public log_system::LogSink
+{
+public:
+    bool log(const std::string &msg) override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _entered += msg;
+        _cond.notify_all();
+        _cond.wait(lock, [&]()
+                   { return msg.size() != 1 || msg[0] < 'a' || msg[0] > 'c' || _open.find(msg) != std::string::npos; });
+        return true;
+    }
+    // 等待某条日志开始写入
+    void wait_entered(char c)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.wait(lock, [&]()
+                   { return _entered.find(c) != std::string::npos; });
+    }
+    void open(char c)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _open += c;
+        _cond.notify_all();
+    }
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::string _entered; // 已开始写入的日志
+    std::string _open;    // 已打开的闸门
+};
+
+// 写入时修改另一个落地对象接收的等级的落地类
+class LevelChangeSink : public log_system::LogSink
+{
+public:
+    LevelChangeSink(const log_system::LogSink::ptr &target) : _target(target) {}
+    bool log(const std::string &) override
+    {
+        _target->set_level(log_system::Level::OFF);
+        return true;
+    }
+    log_system::LogSink::ptr _target;
+};
+
+// 在限定时间内运行func，超时说明发生了死锁，直接以失败退出
+template <class F>
+static void run_with_timeout(const char *name, F func)
+{
+    auto done = std::async(std::launch::async, func);
+    if (done.wait_for(std::chrono::seconds(30)) != std::future_status::ready)
+    {
+        fprintf(stderr, "%s: 超时\n", name);
+        _exit(1);
+    }
+    done.get();
+}
+
+int main()
+{
+    log_system::AsynPoolConfig config;
+    config._thread_size = 2;
+    config.set_wake_mode(log_system::WAKE_CPU); // 不自旋，使工作线程频繁挂起
+    CHECK(log_system::add_pool("durable_pool", config));
+    auto file = log_system::FileSink::get_sink(TEST_DIR "durable_" + std::to_string(getpid()) + ".log");
+    CHECK(file != nullptr);
+    CHECK(log_system::add_logger("durable", log_system::ASYNC_LOGGER, {file}, log_system::Level::DEBUG, "%m%n", "durable_pool"));
+    auto logger = log_system::get_logger("durable");
+
+    // 同一队列两个工作线程，每条持久化日志之后紧跟一条普通日志再等待：取走持久化日志的工作线程暂存着它时，
+    // 另一个工作线程取走普通日志后挂起，暂存的日志必须仍能提交
+    run_with_timeout("serial", [&]()
+                     {
+        for (int i = 0; i < 2000; i++)
+        {
+            auto completion = LOG_DURABLE(logger, log_system::Level::INFO, "durable %d", i);
+            LOG_INFO(logger, "plain %d", i);
+            CHECK(completion->wait());
+        } });
+
+    // 8个线程各自逐条等待500条持久化日志
+    run_with_timeout("threads", [&]()
+                     {
+        std::vector<std::thread> threads;
+        std::atomic<size_t> ok{0};
+        for (int t = 0; t < 8; t++)
+        {
+            threads.emplace_back([&, t]()
+                                 {
+                for (int i = 0; i < 500; i++)
+                    ok += LOG_DURABLE(logger, log_system::Level::INFO, "thread %d record %d", t, i)->wait();
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        CHECK(ok == 8 * 500); });
+    CHECK(logger->flush());
+    size_t lines = 0;
+    FILE *fp = fopen((TEST_DIR "durable_" + std::to_string(getpid()) + ".log").c_str(), "r");
+    CHECK(fp != nullptr);
+    for (int c; fp != nullptr && (c = fgetc(fp)) != EOF;)
+        lines += c == '\n';
+    if (fp != nullptr)
+        fclose(fp);
+    CHECK(lines == 2000 * 2 + 8 * 500);
+
+    // 线程池的flush()返回时，之前输出的要求同步的日志都已完成组提交
+    log_system::LogSink::ptr slow(new SlowSyncSink());
+    CHECK(log_system::add_logger("durable_slow", log_system::ASYNC_LOGGER, {slow}, log_system::Level::DEBUG, "%m%n", "durable_pool"));
+    auto slow_logger = log_system::get_logger("durable_slow");
+    run_with_timeout("flush", [&]()
+                     {
+        std::vector<log_system::LogCompletion::ptr> completions;
+        for (int i = 0; i < 1000; i++)
+            completions.push_back(LOG_DURABLE(slow_logger, log_system::Level::INFO, "record %d", i));
+        LOG_INFO(slow_logger, "plain"); // 最后一条普通日志可能由另一个工作线程处理完毕，此时持久化日志仍需等待组提交
+        slow_logger->pool()->flush();
+        for (auto &completion : completions)
+            CHECK(completion->done() && completion->ok()); });
+    CHECK(((SlowSyncSink *)slow.get())->_written == 1001);
+    CHECK(((SlowSyncSink *)slow.get())->_flushes < 1000); // 多条日志共用一次同步
+
+    // 工作线程W2暂存着持久化日志d时，另一个工作线程W1处理完最后一条日志，线程池的flush()也要等到d组提交后才返回
+    GateSink *gate = new GateSink();
+    log_system::LogSink::ptr gate_sink(gate);
+    CHECK(log_system::add_logger("durable_gate", log_system::ASYNC_LOGGER, {gate_sink}, log_system::Level::DEBUG, "%m", "durable_pool"));
+    auto gate_logger = log_system::get_logger("durable_gate");
+    run_with_timeout("flush_pending", [&]()
+                     {
+        LOG_INFO(gate_logger, "a"); // W1阻塞在a
+        gate->wait_entered('a');
+        LOG_INFO(gate_logger, "c"); // W2阻塞在c
+        gate->wait_entered('c');
+        auto completion = LOG_DURABLE(slow_logger, log_system::Level::INFO, "d");
+        LOG_INFO(gate_logger, "b");
+        LOG_INFO(gate_logger, "p");
+        gate->open('c'); // W2取走d、b、p这一批：暂存d后阻塞在b
+        gate->wait_entered('b');
+        gate->open('a'); // W1取走最后一条日志p
+        gate->wait_entered('p');
+        std::thread flusher([&]()
+                            {
+            slow_logger->pool()->flush();
+            CHECK(completion->done()); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        gate->open('b');
+        flusher.join(); });
+
+    // 写入过程中落地对象的等级发生变化时，完成通知仍按log_durable()筛选出的落地对象完成
+    log_system::LogSink::ptr target(new SlowSyncSink());
+    log_system::LogSink::ptr changer(new LevelChangeSink(target));
+    auto sync_logger = log_system::LoggerManager::get_instance()->create_logger("durable_level", log_system::SYNC_LOGGER, {changer, target}, log_system::Level::DEBUG, "%m%n");
+    run_with_timeout("level", [&]()
+                     { CHECK(LOG_DURABLE(sync_logger, log_system::Level::INFO, "record")->wait()); });
+    CHECK(((SlowSyncSink *)target.get())->_written == 1);
+    return test_result("test_durable");
+}
@@ -0,0 +1,64 @@
+// 检查日志器的创建和销毁：不合法的格式化字符串在创建时被拒绝，异步日志器销毁后缓冲区不再持有其落地对象；
+// 以及输出ERROR日志的同时开关回溯功能不会出错，LOG宏只对日志器参数求值一次
+#include "test.h"
+#include <thread>
+
+// 只统计日志条数的落地类
+class CountSink : public log_system::LogSink
+{
+public:
+    bool log(const std::string &) override
+    {
+        _count++;
+        return true;
+    }
+    std::atomic<size_t> _count{0};
+};
+
+int main()
+{
+    auto manager = log_system::LoggerManager::get_instance();
+    log_system::LogSink::ptr sink(new CountSink());
+    CHECK(manager->create_logger("bad_pattern", log_system::SYNC_LOGGER, {sink}, log_system::Level::DEBUG, "[%Q]%n") == nullptr);
+    CHECK(!manager->add_logger("bad_pattern", log_system::ASYNC_LOGGER, {sink}, log_system::Level::DEBUG, "[%Q]%n"));
+    CHECK(manager->get_logger("bad_pattern") == nullptr);
+
+    {
+        log_system::Logger::ptr logger = manager->create_logger("release_sink", log_system::ASYNC_LOGGER, {sink}, log_system::Level::DEBUG, "%m%n");
+        CHECK(logger != nullptr);
+        for (int i = 0; i < 1000; i++)
+            LOG_INFO(logger, "record %d", i);
+        CHECK(logger->flush());
+    }
+    CHECK(((CountSink *)sink.get())->_count == 1000);
+    CHECK(sink.use_count() == 1); // 日志器销毁后，线程池的缓冲区和工作线程都不再引用该落地对象
+
+    size_t before = ((CountSink *)sink.get())->_count;
+    // 输出ERROR日志触发回溯的同时，另一个线程反复开关回溯功能
+    log_system::Logger::ptr backtrace = manager->create_logger("backtrace_toggle", log_system::SYNC_LOGGER, {sink}, log_system::Level::INFO, "%m%n");
+    std::atomic<bool> stop{false};
+    std::thread toggler([&]()
+                        {
+        for (size_t i = 0; !stop.load(); i++)
+            backtrace->enable_backtrace(i % 2 == 0 ? 0 : 4); });
+    for (int i = 0; i < 20000; i++)
+    {
+        LOG_DEBUG(backtrace, "context %d", i);
+        LOG_ERROR(backtrace, "error %d", i);
+    }
+    stop = true;
+    toggler.join();
+    CHECK(((CountSink *)sink.get())->_count >= before + 20000); // 每条ERROR日志都已输出，另有部分回溯的DEBUG日志
+
+    // LOG宏只对日志器表达式求值一次，无论日志是否通过等级过滤
+    size_t calls = 0;
+    auto get_logger = [&]()
+    {
+        calls++;
+        return backtrace;
+    };
+    LOG_ERROR(get_logger(), "once");
+    LOG_DEBUG(get_logger(), "filtered");
+    CHECK(calls == 2);
+    return test_result("test_logger");
+}
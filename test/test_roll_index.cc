@@ -0,0 +1,55 @@
+// 检查滚动文件落地的索引：滚动时写满的文件由后台线程建立索引，索引覆盖该文件的全部日志
+#include "test.h"
+#include <dirent.h>
+#include <thread>
+#include <chrono>
+
+int main()
+{
+    std::string dir = TEST_DIR "roll_index_" + std::to_string(getpid()) + "/";
+    auto sink = log_system::RollFileSinkBySize::get_sink(dir + "app.log", 1024);
+    CHECK(sink != nullptr);
+    CHECK(!sink->set_index_format("%m"));
+    CHECK(sink->set_index_format("%m%n"));
+    for (int i = 0; i < 200; i++)
+        CHECK(sink->log("record " + std::to_string(i) + "\n"));
+    // 滚动只在与当前文件的创建时间不在同一秒时发生
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    CHECK(sink->log("record 200\n"));
+    log_system::IndexBuilder::wait();
+
+    std::vector<std::string> logs;
+    DIR *d = opendir(dir.c_str());
+    CHECK(d != nullptr);
+    while (d != nullptr)
+    {
+        struct dirent *ent = readdir(d);
+        if (ent == nullptr)
+            break;
+        std::string name = ent->d_name;
+        if (name != "." && name != ".." && name.find(LOG_INDEX_SUFFIX) == std::string::npos)
+            logs.push_back(dir + name);
+    }
+    if (d != nullptr)
+        closedir(d);
+    CHECK(logs.size() == 2);
+
+    // 只有写满的文件建立了索引，当前正在写入的文件没有
+    size_t indexed = 0;
+    for (auto &path : logs)
+    {
+        log_system::LogIndex index;
+        if (!index.load(path))
+            continue;
+        indexed++;
+        struct stat att;
+        CHECK(stat(path.c_str(), &att) == 0 && index.indexed_size() == (size_t)att.st_size);
+        size_t records = 0;
+        for (size_t i = 0; i < index.block_count(); i++)
+            records += index.entry(i)._records;
+        CHECK(records == 200);
+        CHECK(index.fmt() == "%m%n");
+    }
+    CHECK(indexed == 1);
+    return test_result("test_roll_index");
+}
@@ -0,0 +1,137 @@
+// 检查ShmChannelSink：多个进程写入的日志全部按各进程内的顺序送达唯一的消费者，消费者空闲时在futex上等待而不是轮询，
+// 消费者进程退出后其他进程可以接管，存活的消费者不会被抢占
+#include "test.h"
+#include <sys/wait.h>
+#include <dirent.h>
+#include <thread>
+#include <chrono>
+
+#define SHM_NAME "log_system_test_shm"
+
+// 按进程分别记录收到的日志序号的落地类
+class CollectSink : public log_system::LogSink
+{
+public:
+    bool log(const std::string &msg) override
+    {
+        int proc = 0, seq = 0;
+        if (sscanf(msg.c_str(), "%d %d", &proc, &seq) != 2 || proc < 0 || proc >= 8)
+            return false;
+        std::unique_lock<std::mutex> lock(_mutex);
+        _in_order &= seq == _next[proc];
+        _next[proc] = seq + 1;
+        _count++;
+        return true;
+    }
+    std::mutex _mutex;
+    int _next[8] = {0};
+    size_t _count = 0;
+    bool _in_order = true;
+};
+
+// 当前进程所有线程的主动上下文切换次数之和，用于统计空闲时的唤醒次数
+static long voluntary_switches()
+{
+    long total = 0;
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == nullptr)
+        return -1;
+    while (struct dirent *ent = readdir(dir))
+    {
+        if (ent->d_name[0] == '.')
+            continue;
+        std::string path = std::string("/proc/self/task/") + ent->d_name + "/status";
+        FILE *fp = fopen(path.c_str(), "r");
+        char line[256];
+        while (fp != nullptr && fgets(line, sizeof(line), fp) != nullptr)
+        {
+            long n;
+            if (sscanf(line, "voluntary_ctxt_switches: %ld", &n) == 1)
+                total += n;
+        }
+        if (fp != nullptr)
+            fclose(fp);
+    }
+    closedir(dir);
+    return total;
+}
+
+static bool wait_count(CollectSink *collect, size_t count)
+{
+    for (int i = 0; i < 500; i++)
+    {
+        {
+            std::unique_lock<std::mutex> lock(collect->_mutex);
+            if (collect->_count >= count)
+                return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+int main()
+{
+    log_system::ShmChannelSink::remove(SHM_NAME);
+    auto sink = log_system::ShmChannelSink::get_sink(SHM_NAME, 1 << 16, 64);
+    CHECK(sink != nullptr);
+
+    // 存活的消费者不会被抢占，消费者进程退出后可以被接管
+    int ready[2];
+    CHECK(pipe(ready) == 0);
+    pid_t consumer = fork();
+    if (consumer == 0)
+    {
+        bool ok = sink->start_consumer(log_system::LogSink::ptr(new CollectSink()));
+        char c = ok ? '1' : '0';
+        (void)!write(ready[1], &c, 1);
+        pause();
+        _exit(0);
+    }
+    char c = 0;
+    CHECK(read(ready[0], &c, 1) == 1 && c == '1');
+    CHECK(!sink->start_consumer(log_system::LogSink::ptr(new CollectSink())));
+    kill(consumer, SIGKILL);
+    waitpid(consumer, nullptr, 0);
+    CollectSink *collect = new CollectSink();
+    CHECK(sink->start_consumer(log_system::LogSink::ptr(collect)));
+
+    // 消费者空闲时不轮询：300ms内的唤醒次数远小于按1ms轮询时的300次
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    long before = voluntary_switches();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    long wakeups = voluntary_switches() - before;
+    CHECK(before >= 0 && wakeups < 20);
+
+    // 多个进程并发写入，每个进程的日志都按顺序送达
+    const int procs = 4, per_proc = 5000;
+    std::vector<pid_t> children;
+    for (int p = 0; p < procs; p++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            for (int i = 0; i < per_proc; i++)
+                sink->log(std::to_string(p) + " " + std::to_string(i) + "\n", log_system::Level::value::INFO);
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    for (pid_t pid : children)
+        waitpid(pid, nullptr, 0);
+    CHECK(wait_count(collect, procs * per_proc));
+    CHECK(collect->_count == (size_t)procs * per_proc);
+    CHECK(collect->_in_order);
+    CHECK(sink->dropped() == 0);
+
+    // 空闲后再写入的单条日志也能被及时唤醒处理
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    auto start = std::chrono::steady_clock::now();
+    sink->log("0 " + std::to_string(per_proc) + "\n", log_system::Level::value::INFO);
+    CHECK(wait_count(collect, procs * per_proc + 1));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(SHM_CONSUMER_IDLE_MS));
+
+    sink->stop_consumer();
+    log_system::ShmChannelSink::remove(SHM_NAME);
+    return test_result("test_shm_channel");
+}
@@ -0,0 +1,136 @@
+// 检查SocketSink：流式套接字按原样发送日志，数据报套接字的每个数据报只包含完整的日志，
+// 对端未启动或断开期间的日志保留在待发送缓冲区中，重连后全部送达
+#include "test.h"
+#include <thread>
+#include <chrono>
+
+#define STREAM_PATH TEST_DIR "socket_stream.sock"
+#define DGRAM_PATH TEST_DIR "socket_dgram.sock"
+
+// 在path上创建Unix域套接字并监听(流式)或绑定(数据报)，失败返回-1
+static int listen_unix(const char *path, int type)
+{
+    unlink(path);
+    int fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (fd == -1 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || (type == SOCK_STREAM && listen(fd, 4) == -1))
+        return -1;
+    return fd;
+}
+
+// 从流式连接中读取数据，直到读到expect的长度或超时
+static std::string read_stream(int fd, size_t expect)
+{
+    std::string ret;
+    char buf[4096];
+    while (ret.size() < expect)
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) <= 0)
+            break;
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+        ret.append(buf, n);
+    }
+    return ret;
+}
+
+static std::string records(const char *prefix, int count)
+{
+    std::string ret;
+    for (int i = 0; i < count; i++)
+        ret += std::string(prefix) + std::to_string(i) + "\n";
+    return ret;
+}
+
+static void log_records(const log_system::SocketSink::ptr &sink, const char *prefix, int count)
+{
+    for (int i = 0; i < count; i++)
+        sink->log(std::string(prefix) + std::to_string(i) + "\n", log_system::Level::value::INFO);
+}
+
+// 对端启动前的日志被保留，连接建立后按顺序送达；对端断开后的日志在重连后送达
+static void test_stream_reconnect()
+{
+    unlink(STREAM_PATH);
+    auto sink = log_system::SocketSink::get_sink(log_system::SOCKET_UNIX_STREAM, STREAM_PATH, 0);
+    CHECK(sink != nullptr);
+    log_records(sink, "before-", 5);
+    CHECK(!sink->connected());
+    CHECK(sink->dropped() == 0);
+
+    int listener = listen_unix(STREAM_PATH, SOCK_STREAM);
+    CHECK(listener != -1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(SOCKET_RECONNECT_MIN_MS * 3)); // 等待重连的退避间隔过去
+    CHECK(sink->flush());
+    int conn = accept(listener, nullptr, nullptr);
+    CHECK(conn != -1);
+    std::string expect = records("before-", 5);
+    CHECK(read_stream(conn, expect.size()) == expect);
+
+    // 对端断开：之后的日志保留在待发送缓冲区中，新的对端启动后重连送达
+    close(conn);
+    close(listener);
+    log_records(sink, "after-", 3);
+    CHECK(!sink->connected());
+    listener = listen_unix(STREAM_PATH, SOCK_STREAM);
+    CHECK(listener != -1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(SOCKET_RECONNECT_MIN_MS * 3));
+    CHECK(sink->flush());
+    conn = accept(listener, nullptr, nullptr);
+    CHECK(conn != -1);
+    expect = records("after-", 3);
+    CHECK(read_stream(conn, expect.size()) == expect);
+    CHECK(sink->dropped() == 0);
+    close(conn);
+    close(listener);
+}
+
+// 数据报套接字攒批发送时，每个数据报都由若干条完整的日志组成
+static void test_dgram_boundaries()
+{
+    int receiver = listen_unix(DGRAM_PATH, SOCK_DGRAM);
+    CHECK(receiver != -1);
+    auto sink = log_system::SocketSink::get_sink(log_system::SOCKET_UNIX_DGRAM, DGRAM_PATH, 64 * 1024);
+    CHECK(sink != nullptr);
+    std::string all;
+    for (int i = 0; i < 2000; i++)
+    {
+        std::string rec = "record-" + std::to_string(i) + "-" + std::string(i % 97, 'x') + "\n";
+        all += rec;
+        sink->log(rec, log_system::Level::value::INFO);
+    }
+    CHECK(sink->flush());
+    std::string received;
+    size_t datagrams = 0;
+    std::vector<char> buf(SOCKET_DGRAM_MAX_SIZE + 1);
+    while (received.size() < all.size())
+    {
+        struct pollfd pfd = {receiver, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) <= 0)
+            break;
+        ssize_t n = recv(receiver, buf.data(), buf.size(), 0);
+        if (n <= 0)
+            break;
+        datagrams++;
+        CHECK((size_t)n <= SOCKET_DGRAM_MAX_SIZE);
+        CHECK(buf[n - 1] == '\n');                                 // 数据报以一条日志的结尾结束
+        CHECK(all.compare(received.size(), 7, "record-", 7) == 0); // 并以一条日志的开头开始
+        received.append(buf.data(), n);
+    }
+    CHECK(received == all);
+    CHECK(datagrams > 1);
+    close(receiver);
+}
+
+int main()
+{
+    log_system::Util::create_dir(TEST_DIR);
+    test_stream_reconnect();
+    test_dgram_boundaries();
+    return test_result("test_socket_sink");
+}
@@ -0,0 +1,130 @@
+// 检查SyslogSink：按RFC 5424组装的消息头，fork出的子进程发送的日志带有子进程的进程ID，以及守护进程来不及接收(EAGAIN)时未发送的日志被保留并在之后送达
+#include "test.h"
+#include <sys/wait.h>
+
+#define SYSLOG_PATH TEST_DIR "syslog.sock"
+
+static int bind_dgram(const char *path)
+{
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (fd == -1 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        return -1;
+    return fd;
+}
+
+// 非阻塞地接收一个数据报，没有数据时返回false
+static bool recv_record(int fd, std::string &out)
+{
+    char buf[8192];
+    ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n < 0)
+        return false;
+    out.assign(buf, n);
+    return true;
+}
+
+static bool is_digits(const std::string &str, size_t pos, size_t len)
+{
+    if (pos + len > str.size())
+        return false;
+    for (size_t i = pos; i < pos + len; i++)
+    {
+        if (!isdigit((unsigned char)str[i]))
+            return false;
+    }
+    return true;
+}
+
+// <PRI>1 YYYY-MM-DDTHH:MM:SS.ffffff(Z|±HH:MM) HOSTNAME APP-NAME PROCID - - MSG
+static void test_header(const log_system::SyslogSink::ptr &sink, int fd, const std::string &app_name)
+{
+    CHECK(sink->log("hello syslog\n", log_system::Level::value::ERROR));
+    std::string rec;
+    CHECK(recv_record(fd, rec));
+    CHECK(rec.compare(0, 6, "<11>1 ") == 0); // facility 1 * 8 + severity 3
+    size_t pos = 6;
+    CHECK(is_digits(rec, pos, 4) && rec[pos + 4] == '-' && is_digits(rec, pos + 5, 2) && rec[pos + 7] == '-' &&
+          is_digits(rec, pos + 8, 2) && rec[pos + 10] == 'T' && is_digits(rec, pos + 11, 2) && rec[pos + 13] == ':' &&
+          is_digits(rec, pos + 14, 2) && rec[pos + 16] == ':' && is_digits(rec, pos + 17, 2) && rec[pos + 19] == '.' &&
+          is_digits(rec, pos + 20, 6));
+    pos += 26;
+    if (rec[pos] == 'Z')
+        pos += 1;
+    else
+    {
+        CHECK((rec[pos] == '+' || rec[pos] == '-') && is_digits(rec, pos + 1, 2) && rec[pos + 3] == ':' && is_digits(rec, pos + 4, 2));
+        pos += 6;
+    }
+    CHECK(rec[pos] == ' ');
+    size_t host_end = rec.find(' ', pos + 1);
+    CHECK(host_end != std::string::npos && host_end - pos - 1 <= SYSLOG_HOSTNAME_MAX);
+    std::string expect = " " + app_name.substr(0, SYSLOG_APP_NAME_MAX) + " " + std::to_string(getpid()) + " - - hello syslog";
+    CHECK(rec.compare(host_end, std::string::npos, expect) == 0); // APP-NAME被截断为48个字符，日志结尾的换行被去掉
+}
+
+// fork出的子进程通过同一个对象发送的日志，PROCID为子进程的ID
+static void test_fork_procid(const log_system::SyslogSink::ptr &sink, int fd, const std::string &app_name)
+{
+    pid_t child = fork();
+    if (child == 0)
+    {
+        sink->log("from child\n", log_system::Level::value::ERROR);
+        _exit(0);
+    }
+    CHECK(child > 0);
+    int status = 0;
+    waitpid(child, &status, 0);
+    std::string rec;
+    CHECK(recv_record(fd, rec));
+    std::string expect = " " + std::to_string(child) + " - - from child";
+    CHECK(rec.size() >= expect.size() && rec.compare(rec.size() - expect.size(), expect.size(), expect) == 0);
+    test_header(sink, fd, app_name); // 父进程中仍是父进程的ID
+}
+
+// 接收方的队列满时，发送不了的日志留在批次中，队列腾出空间后由flush()送达，不计入丢弃
+static void test_eagain_keeps_records(const log_system::SyslogSink::ptr &sink, int fd)
+{
+    int sent = 0;
+    while (sent < 100000 && sink->log("record " + std::to_string(sent) + "\n", log_system::Level::value::INFO))
+        sent++;
+    CHECK(sent < 100000); // 接收方的队列已满
+    CHECK(sink->dropped() == 0);
+    std::string rec;
+    int received = 0;
+    bool in_order = true;
+    for (int round = 0; round < 100 && received <= sent; round++)
+    {
+        while (recv_record(fd, rec))
+        {
+            std::string tail = " - - record " + std::to_string(received);
+            in_order &= rec.size() >= tail.size() && rec.compare(rec.size() - tail.size(), tail.size(), tail) == 0;
+            received++;
+        }
+        sink->flush();
+    }
+    CHECK(in_order);
+    CHECK(received == sent + 1); // 包括触发EAGAIN的那条日志
+    CHECK(sink->dropped() == 0);
+}
+
+int main()
+{
+    log_system::Util::create_dir(TEST_DIR);
+    int fd = bind_dgram(SYSLOG_PATH);
+    CHECK(fd != -1);
+    std::string app_name(60, 'a');
+    app_name[3] = ' '; // 不可打印的字符被替换为'_'
+    auto sink = log_system::SyslogSink::get_sink(app_name, 1, SYSLOG_PATH, 1);
+    CHECK(sink != nullptr);
+    app_name[3] = '_';
+    test_header(sink, fd, app_name);
+    test_fork_procid(sink, fd, app_name);
+    test_eagain_keeps_records(sink, fd);
+    close(fd);
+    return test_result("test_syslog_sink");
+}
@@ -0,0 +1,21 @@
+// 检查%i输出的线程id：缓存的线程id与gettid一致，fork()出的子进程中输出的是子进程自己的线程id
+#include "test.h"
+#include <sys/wait.h>
+
+int main()
+{
+    log_system::Util::ThreadInfo &info = log_system::Util::thread_info();
+    CHECK(info._tid == (pid_t)syscall(SYS_gettid));
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        log_system::Util::ThreadInfo &child = log_system::Util::thread_info();
+        bool ok = child._tid == getpid() && std::to_string(getpid()) == std::string(child._tid_str, child._tid_len);
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK(info._tid == (pid_t)syscall(SYS_gettid)); // 父进程中的缓存不受影响
+    return test_result("test_thread_info");
+}
@@ -2,7 +2,15 @@
 #define LOG_SYSTEM_UTIL_HPP
 
 #include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_set>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -68,31 +76,181 @@ namespace log_system
             size_t pos = ret.find_last_of('/'); // 经过is_path()的调用，ret中一定有'/',且除了根目录ret不以'/'结尾
             return ret.substr(0, pos + 1);
         }
+        // 已确认存在的目录的缓存，避免为大量位于同一目录下的文件重复检查和创建目录
+        std::unordered_set<std::string> &dir_cache()
+        {
+            static std::unordered_set<std::string> dirs;
+            return dirs;
+        }
+        std::mutex &dir_cache_mutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+        // 清空已存在目录的缓存，目录可能被外部删除时(如打开文件失败)调用
+        void forget_dirs()
+        {
+            std::unique_lock<std::mutex> lock(dir_cache_mutex());
+            dir_cache().clear();
+        }
         // 根据path路径创建目录，如果已经存在就直接返回真
+        // 已确认存在的目录会被缓存，之后再创建同一目录或其子目录时只需为缓存中没有的部分调用mkdir()
         bool create_dir(const std::string &path)
         {
             std::string ret = is_path(path);
             if (ret == "")
                 return false;
-            if (file_exist(ret) == true)
+            std::unique_lock<std::mutex> lock(dir_cache_mutex());
+            auto &dirs = dir_cache();
+            if (dirs.count(ret))
                 return true;
-
             size_t lpos = 0, rpos = 0;
             while (lpos < ret.size())
             {
                 rpos = ret.find_first_of('/', lpos);
                 lpos = rpos == std::string::npos ? rpos : rpos + 1;
                 std::string sstr = ret.substr(0, lpos);
-                if (file_exist(sstr) == true)
+                if (dirs.count(sstr))
                     continue;
-                else
+                if (mkdir(sstr.c_str(), default_dir_mode) == -1 && errno != EEXIST)
+                    return false;
+                dirs.insert(sstr);
+            }
+            dirs.insert(ret);
+            return true;
+        }
+        // 循环调用write()直到将len字节的数据全部写入fd，被信号中断时自动重试，只使用异步信号安全的调用，成功返回true
+        bool write_all(int fd, const char *buf, size_t len)
+        {
+            while (len > 0)
+            {
+                ssize_t n = write(fd, buf, len);
+                if (n == -1 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                buf += n, len -= n;
+            }
+            return true;
+        }
+        // 解析形如"0-3,8,10-11"的CPU列表字符串，格式错误时返回false
+        bool parse_cpulist(const std::string &str, std::vector<int> &cpus)
+        {
+            size_t pos = 0;
+            while (pos < str.size() && str[pos] != '\n')
+            {
+                char *end;
+                long first = strtol(str.c_str() + pos, &end, 10), last = first;
+                if (end == str.c_str() + pos || first < 0)
+                    return false;
+                pos = end - str.c_str();
+                if (pos < str.size() && str[pos] == '-')
                 {
-                    if (mkdir(sstr.c_str(), default_dir_mode) == -1)
+                    last = strtol(str.c_str() + pos + 1, &end, 10);
+                    if (end == str.c_str() + pos + 1 || last < first)
                         return false;
+                    pos = end - str.c_str();
                 }
+                for (long cpu = first; cpu <= last; cpu++)
+                    cpus.push_back((int)cpu);
+                if (pos < str.size() && str[pos] == ',')
+                    pos++;
             }
             return true;
         }
+        // 读取sysfs等伪文件系统中的文件的第一行并解析为CPU列表或节点列表，失败返回false
+        bool read_cpulist(const std::string &path, std::vector<int> &list)
+        {
+            FILE *fp = fopen(path.c_str(), "r");
+            if (fp == nullptr)
+                return false;
+            char buf[4096] = {0};
+            bool ret = fgets(buf, sizeof(buf), fp) != nullptr && parse_cpulist(buf, list);
+            fclose(fp);
+            return ret;
+        }
+        // 获取NUMA拓扑，返回每个NUMA节点包含的CPU编号(下标为节点编号，不存在的节点为空数组)
+        // 只在第一次调用时从/sys/devices/system/node中读取，读取失败或系统不支持NUMA时返回空数组
+        const std::vector<std::vector<int>> &numa_nodes()
+        {
+            static const std::vector<std::vector<int>> nodes = []()
+            {
+                std::vector<std::vector<int>> ret;
+                std::vector<int> online;
+                if (!read_cpulist("/sys/devices/system/node/online", online))
+                    return ret;
+                for (int node : online)
+                {
+                    std::vector<int> cpus;
+                    if (!read_cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", cpus))
+                        return std::vector<std::vector<int>>();
+                    if ((int)ret.size() <= node)
+                        ret.resize(node + 1);
+                    ret[node] = cpus;
+                }
+                return ret;
+            }();
+            return nodes;
+        }
+        // 获取cpu所属的NUMA节点编号，无法获取时返回-1
+        int cpu_node(int cpu)
+        {
+            auto &nodes = numa_nodes();
+            for (size_t node = 0; node < nodes.size(); node++)
+            {
+                for (int c : nodes[node])
+                {
+                    if (c == cpu)
+                        return (int)node;
+                }
+            }
+            return -1;
+        }
+        // 自旋等待时调用，提示CPU当前处于忙等状态，降低功耗并让出流水线资源给同核的其他超线程
+        inline void cpu_relax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+        // 线程信息，每个线程第一次使用时获取一次操作系统线程id并预先转化成字符串，之后直接使用缓存的结果
+        struct ThreadInfo
+        {
+            pid_t _tid;        // 操作系统线程id(gettid)
+            char _tid_str[16]; // _tid转化成的字符串
+            size_t _tid_len;   // _tid_str的长度
+            std::string _name; // 用户设置的线程名称，未设置时为空
+        };
+        ThreadInfo &thread_info();
+        // 重新获取当前线程的操作系统线程id
+        void resolve_tid(ThreadInfo &info)
+        {
+            info._tid = (pid_t)syscall(SYS_gettid);
+            info._tid_len = snprintf(info._tid_str, sizeof(info._tid_str), "%d", (int)info._tid);
+        }
+        // 获取当前线程的线程信息
+        // fork()出的子进程中只有调用fork()的线程，其缓存的仍是父进程中的线程id，因此通过pthread_atfork()在子进程中重新获取
+        ThreadInfo &thread_info()
+        {
+            thread_local ThreadInfo info = []()
+            {
+                static int atfork = pthread_atfork(nullptr, nullptr, []()
+                                                   { resolve_tid(thread_info()); });
+                (void)atfork;
+                ThreadInfo tmp;
+                resolve_tid(tmp);
+                return tmp;
+            }();
+            return info;
+        }
+        // 设置当前线程的名称，同时尝试设置操作系统中的线程名称(超出15个字符的部分会被系统截断)
+        void set_thread_name(const std::string &name)
+        {
+            thread_info()._name = name;
+            pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+        }
         // 根据路径返回文件名，如果path为根目录或者路径有问题就返回空串
         std::string get_fname(const std::string &path)
         {